@@ -1,12 +1,10 @@
 #version 330 core
 
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 norm;
+layout(location = 1) in vec2 norm;      // octahedral encoded, see vertex_packing.h
 layout(location = 2) in vec2 tex;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec3 bitangent;
-layout(location = 5) in ivec4 boneIds; 
-layout(location = 6) in vec4 weights;
+layout(location = 5) in uvec4 boneIds;  // 8-bit ids
+layout(location = 6) in vec4 weights;   // 8-bit unorm, sum to 1
 
 uniform mat4 projection;
 uniform mat4 view;
@@ -17,25 +15,42 @@ const int MAX_BONE_INFLUENCE = 4;
 uniform mat4 finalBonesMatrices[MAX_BONES];
 
 out vec2 TexCoords;
+out vec3 ViewPos;
+out vec3 ViewNormal;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
 
 void main()
 {
     vec4 totalPosition = vec4(0.0f);
+    vec3 totalNormal = vec3(0.0f);
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
     {
-        if(boneIds[i] == -1) 
+        if(weights[i] == 0.0) 
             continue;
-        if(boneIds[i] >=MAX_BONES) 
+        if(int(boneIds[i]) >=MAX_BONES) 
         {
             totalPosition = vec4(pos,1.0f);
+            totalNormal = octDecode(norm);
             break;
         }
         vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
         totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
+        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * octDecode(norm);
+        totalNormal += localNormal * weights[i];
    }
 	
     mat4 viewModel = view * model;
-    gl_Position =  projection * viewModel * totalPosition;
+    vec4 viewPosition = viewModel * totalPosition;
+    gl_Position =  projection * viewPosition;
 	TexCoords = tex;
+    // lighting is done in view space, see clustered_lighting.h
+    ViewPos = viewPosition.xyz;
+    ViewNormal = mat3(transpose(inverse(viewModel))) * totalNormal;
 }
@@ -0,0 +1,77 @@
+#version 330 core
+
+// crowd variant of anim_model.vs: bone matrices come from a baked texture (see baked_animation.h)
+// instead of uniforms, and the model matrix and playback state are per instance
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec2 norm;      // octahedral encoded, see vertex_packing.h
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec4 instanceAnimation;    // first frame, frame count, frames per second, offset in frames
+layout(location = 5) in uvec4 boneIds;  // 8-bit ids
+layout(location = 6) in vec4 weights;   // 8-bit unorm, sum to 1
+layout(location = 7) in mat4 instanceModel;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+uniform sampler2D bakedBones;   // row per frame, 3 texels per bone
+uniform int bakedBoneCount;
+uniform float time;
+
+const int MAX_BONE_INFLUENCE = 4;
+
+out vec2 TexCoords;
+out vec3 ViewPos;
+out vec3 ViewNormal;
+
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+mat4 bakedBone(int frame, int bone)
+{
+    int x = bone * 3;
+    vec4 row0 = texelFetch(bakedBones, ivec2(x, frame), 0);
+    vec4 row1 = texelFetch(bakedBones, ivec2(x + 1, frame), 0);
+    vec4 row2 = texelFetch(bakedBones, ivec2(x + 2, frame), 0);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+void main()
+{
+    // the two baked frames around this instance's playback time
+    float frameCount = instanceAnimation.y;
+    float frame = mod(time * instanceAnimation.z + instanceAnimation.w, frameCount);
+    int frame0 = int(instanceAnimation.x) + int(frame);
+    int frame1 = int(instanceAnimation.x) + int(mod(floor(frame) + 1.0, frameCount));
+    float blend = fract(frame);
+
+    vec3 normal = octDecode(norm);
+    vec4 totalPosition = vec4(0.0f);
+    vec3 totalNormal = vec3(0.0f);
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    {
+        if(weights[i] == 0.0) 
+            continue;
+        if(int(boneIds[i]) >= bakedBoneCount) 
+        {
+            totalPosition = vec4(pos,1.0f);
+            totalNormal = normal;
+            break;
+        }
+        mat4 bone = bakedBone(frame0, int(boneIds[i])) * (1.0 - blend) + bakedBone(frame1, int(boneIds[i])) * blend;
+        totalPosition += bone * vec4(pos,1.0f) * weights[i];
+        totalNormal += mat3(bone) * normal * weights[i];
+    }
+
+    mat4 viewModel = view * instanceModel;
+    vec4 viewPosition = viewModel * totalPosition;
+    gl_Position = projection * viewPosition;
+    TexCoords = tex;
+    // lighting is done in view space, see clustered_lighting.h
+    ViewPos = viewPosition.xyz;
+    ViewNormal = mat3(transpose(inverse(viewModel))) * totalNormal;
+}
@@ -0,0 +1,156 @@
+#ifndef ANIMATION_FORMAT_H
+#define ANIMATION_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include "scene_format.h"
+#include "skeleton.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary skeleton + clips (native endianness), cooked from assimp-loaded animations so programs
+// without assimp or GL, like the simulation server, can evaluate the same poses:
+//
+//   AnimationFileHeader
+//   joints  jointCount x { string name, int32 parent, int32 boneId, mat4 offset, mat4 bindLocal }
+//   clips   clipCount  x { string name, float duration, uint32 frameCount,
+//                          uint8 animated[jointCount], JointPose keys[frameCount][jointCount] }
+//
+// Strings are written as in scene files.
+
+const char ANIMATION_MAGIC[4] = { 'A', 'N', 'I', 'M' };
+const uint32_t ANIMATION_VERSION = 1;
+
+struct AnimationFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t jointCount;
+    uint32_t boneCount;
+    uint32_t clipCount;
+};
+
+static_assert(std::is_trivially_copyable<JointPose>::value, "JointPose is written to disk as raw bytes");
+
+inline bool writeAnimationFile(const std::string& path, const Skeleton& skeleton, const std::vector<const SkeletonClip*>& clips)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::ANIMATION::FAILED_TO_OPEN_FOR_WRITING " << path << std::endl;
+        return false;
+    }
+
+    AnimationFileHeader header;
+    std::memcpy(header.magic, ANIMATION_MAGIC, sizeof(header.magic));
+    header.version = ANIMATION_VERSION;
+    header.jointCount = static_cast<uint32_t>(skeleton.Joints.size());
+    header.boneCount = skeleton.BoneCount;
+    header.clipCount = static_cast<uint32_t>(clips.size());
+    scene_io::writeRaw(out, header);
+
+    for (const Skeleton::Joint& joint : skeleton.Joints)
+    {
+        scene_io::writeString(out, joint.name);
+        scene_io::writeRaw(out, static_cast<int32_t>(joint.parent));
+        scene_io::writeRaw(out, static_cast<int32_t>(joint.boneId));
+        scene_io::writeRaw(out, joint.offset);
+        scene_io::writeRaw(out, joint.bindLocal);
+    }
+
+    for (const SkeletonClip* clip : clips)
+    {
+        scene_io::writeString(out, clip->Name);
+        scene_io::writeRaw(out, clip->Duration);
+        scene_io::writeRaw(out, static_cast<uint32_t>(clip->FrameCount));
+        for (unsigned int joint = 0; joint < clip->JointCount(); joint++)
+            scene_io::writeRaw(out, static_cast<uint8_t>(clip->Animated(joint) ? 1 : 0));
+        for (unsigned int frame = 0; frame < clip->FrameCount; frame++)
+            for (unsigned int joint = 0; joint < clip->JointCount(); joint++)
+                scene_io::writeRaw(out, clip->Key(frame, joint));
+    }
+    return static_cast<bool>(out);
+}
+
+// fills skeleton and clips (replacing their contents); clips are owned by the caller
+inline bool readAnimationFile(const std::string& path, Skeleton& skeleton, std::vector<SkeletonClip>& clips)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        std::cout << "ERROR::ANIMATION::FILE_NOT_FOUND " << path << std::endl;
+        return false;
+    }
+
+    AnimationFileHeader header;
+    if (!scene_io::readRaw(in, header) || std::memcmp(header.magic, ANIMATION_MAGIC, sizeof(header.magic)) != 0)
+    {
+        std::cout << "ERROR::ANIMATION::NOT_AN_ANIMATION_FILE " << path << std::endl;
+        return false;
+    }
+    if (header.version != ANIMATION_VERSION)
+    {
+        std::cout << "ERROR::ANIMATION::UNSUPPORTED_VERSION " << header.version << " in " << path << std::endl;
+        return false;
+    }
+
+    skeleton = Skeleton();
+    for (uint32_t i = 0; i < header.jointCount; i++)
+    {
+        std::string name;
+        int32_t parent, boneId;
+        glm::mat4 offset, bindLocal;
+        if (!scene_io::readString(in, name) || !scene_io::readRaw(in, parent) || !scene_io::readRaw(in, boneId) ||
+            !scene_io::readRaw(in, offset) || !scene_io::readRaw(in, bindLocal))
+        {
+            std::cout << "ERROR::ANIMATION::TRUNCATED_FILE " << path << std::endl;
+            return false;
+        }
+        skeleton.AddJoint(name, parent, boneId, offset, bindLocal);
+    }
+    skeleton.BoneCount = std::max(skeleton.BoneCount, header.boneCount);
+    skeleton.Finalize();
+
+    clips.clear();
+    clips.reserve(header.clipCount);
+    for (uint32_t c = 0; c < header.clipCount; c++)
+    {
+        std::string name;
+        float duration;
+        uint32_t frameCount;
+        if (!scene_io::readString(in, name) || !scene_io::readRaw(in, duration) || !scene_io::readRaw(in, frameCount) || frameCount == 0)
+        {
+            std::cout << "ERROR::ANIMATION::TRUNCATED_FILE " << path << std::endl;
+            return false;
+        }
+        clips.emplace_back(skeleton, name, duration, frameCount);
+        SkeletonClip& clip = clips.back();
+        for (unsigned int joint = 0; joint < header.jointCount; joint++)
+        {
+            uint8_t animated = 0;
+            scene_io::readRaw(in, animated);
+            clip.SetAnimated(joint, animated != 0);
+        }
+        for (unsigned int frame = 0; frame < frameCount; frame++)
+            for (unsigned int joint = 0; joint < header.jointCount; joint++)
+            {
+                JointPose key;
+                scene_io::readRaw(in, key);
+                clip.SetKey(frame, joint, key);
+            }
+        if (!in)
+        {
+            std::cout << "ERROR::ANIMATION::TRUNCATED_FILE " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef ANIMATION_LOD_H
+#define ANIMATION_LOD_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "pose_blend.h"
+#include "skeleton.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+enum AnimationLod {
+    ANIM_LOD_FULL = 0,
+    ANIM_LOD_REDUCED,
+    ANIM_LOD_DISTANT,
+    ANIM_LOD_OFFSCREEN,     // playback time keeps running, no pose is evaluated
+    ANIM_LOD_COUNT
+};
+
+struct AnimationLodSettings {
+    // projected height (fraction of the viewport) below which a character drops to the next level
+    float reducedScreenSize = 0.3f;
+    float distantScreenSize = 0.1f;
+    // frames between pose evaluations, per level
+    unsigned int updateInterval[ANIM_LOD_COUNT] = { 1, 2, 4, 0 };
+    // joints whose height (see Skeleton) is below this keep their last sampled local pose:
+    // 1 freezes leaves such as finger tips and face joints, 2 also their parents
+    unsigned int frozenJointHeight[ANIM_LOD_COUNT] = { 0, 1, 2, 0 };
+    // only the largest characters on screen get full detail, the rest are demoted to reduced
+    unsigned int maxFullCharacters = 8;
+    // evaluations per frame; when more are due, the smallest on screen wait for a later frame
+    unsigned int maxEvaluationsPerFrame = 256;
+};
+
+struct AnimationLodStats {
+    unsigned int characters[ANIM_LOD_COUNT] = {};
+    unsigned int evaluations[ANIM_LOD_COUNT] = {};
+    unsigned long long jointsSampled[ANIM_LOD_COUNT] = {};
+    float evaluationMs[ANIM_LOD_COUNT] = {};     // summed over worker threads
+    unsigned int deferred = 0;
+    float totalMs = 0.0f;                       // wall time of Update
+};
+
+// one character driven by the LOD system; Position/Radius is its bounding sphere
+struct AnimatedCharacter {
+    const SkeletonClip* Clip = nullptr;
+    float Time = 0.0f;              // seconds into the clip
+    float PlaybackRate = 1.0f;
+    glm::vec3 Position = glm::vec3(0.0f);
+    float Radius = 1.0f;
+
+    AnimationLod Lod = ANIM_LOD_FULL;
+    std::vector<glm::mat4> BoneMatrices;    // valid once Evaluated() is true
+
+    bool Evaluated() const { return m_Evaluated; }
+
+private:
+    friend class AnimationLodSystem;
+    PoseBuffer m_Pose;                  // local pose in the system's joint order; frozen joints keep what they had
+    const SkeletonClip* m_LodClip = nullptr;
+    std::vector<glm::mat4> m_FrozenBones;   // per frozen joint, its chain below the nearest live joint times its offset
+    unsigned int m_FrozenLive = 0;          // live joint count m_FrozenBones was built for
+    float m_ScreenSize = 0.0f;
+    unsigned int m_FramesSinceEvaluation = 0;
+    bool m_Evaluated = false;
+    float m_EvaluationMs = 0.0f;
+    unsigned int m_JointsSampled = 0;
+};
+
+// Decides per character how often and how completely its pose is evaluated. Levels come from
+// the projected size of the bounding sphere and a frustum test; evaluations at reduced rates are
+// staggered so a crowd doesn't update all at once; skipped frames and frozen joints reuse the
+// last result. Due evaluations run in parallel on the job system.
+// Joints are kept sorted by height, tallest first; a parent is always taller than its children,
+// so the hierarchy order still holds, and the joints a level keeps live are a prefix that the
+// SIMD blend samples on its own and the hierarchy pass walks on its own. A frozen joint's chain
+// down from its nearest live ancestor doesn't change, so it is cached per character and each
+// frozen bone costs one multiply. Each clip is copied into that order the first time it is used;
+// clips must outlive the system.
+class AnimationLodSystem
+{
+public:
+    AnimationLodSystem(const Skeleton& skeleton, const AnimationLodSettings& settings = AnimationLodSettings())
+        : m_Settings(settings)
+    {
+        const unsigned int jointCount = static_cast<unsigned int>(skeleton.Joints.size());
+        for (unsigned int i = 0; i < jointCount; i++)
+            m_JointOrder.push_back(i);
+        std::stable_sort(m_JointOrder.begin(), m_JointOrder.end(), [&](unsigned int a, unsigned int b) {
+            return skeleton.Joints[a].height > skeleton.Joints[b].height;
+        });
+        std::vector<int> sortedIndex(jointCount);
+        for (unsigned int i = 0; i < jointCount; i++)
+            sortedIndex[m_JointOrder[i]] = static_cast<int>(i);
+        for (unsigned int joint : m_JointOrder)
+        {
+            Skeleton::Joint sorted = skeleton.Joints[joint];
+            sorted.parent = sorted.parent >= 0 ? sortedIndex[sorted.parent] : -1;
+            m_Skeleton.Joints.push_back(sorted);
+        }
+        m_Skeleton.BoneCount = skeleton.BoneCount;
+
+        // live joints per frozen height: those at least that tall
+        for (const Skeleton::Joint& joint : m_Skeleton.Joints)
+        {
+            if (m_LiveJoints.size() <= joint.height + 1)
+                m_LiveJoints.resize(joint.height + 2, 0);
+            for (unsigned int height = 0; height <= joint.height; height++)
+                m_LiveJoints[height]++;
+        }
+        // and the live joint each frozen one hangs from, -1 when its whole chain is frozen
+        m_LiveAncestors.resize(m_LiveJoints.size());
+        for (unsigned int height = 0; height < m_LiveJoints.size(); height++)
+        {
+            const unsigned int live = m_LiveJoints[height];
+            for (unsigned int joint = live; joint < jointCount; joint++)
+            {
+                int parent = m_Skeleton.Joints[joint].parent;
+                int ancestor = parent < static_cast<int>(live) ? parent : m_LiveAncestors[height][parent - live];
+                m_LiveAncestors[height].push_back(ancestor);
+            }
+        }
+    }
+
+    AnimationLodSettings& Settings() { return m_Settings; }
+    const AnimationLodStats& Stats() const { return m_Stats; }
+    unsigned int CharacterCount() const { return static_cast<unsigned int>(m_Characters.size()); }
+    AnimatedCharacter& Character(unsigned int index) { return m_Characters[index]; }
+
+    unsigned int Add(const SkeletonClip* clip, const glm::vec3& position, float radius)
+    {
+        AnimatedCharacter character;
+        character.Clip = clip;
+        character.Position = position;
+        character.Radius = radius;
+        character.m_Pose.Resize(static_cast<unsigned int>(m_Skeleton.Joints.size()));
+        for (unsigned int i = 0; i < m_Skeleton.Joints.size(); i++)
+            character.m_Pose.Set(i, decomposeJointPose(m_Skeleton.Joints[i].bindLocal));
+        if (clip)
+            character.m_LodClip = &sortedClip(*clip);
+        m_Characters.push_back(character);
+        return static_cast<unsigned int>(m_Characters.size() - 1);
+    }
+
+    void Update(float deltaTime, const glm::mat4& viewProjection, const glm::vec3& cameraPosition, float fovY, JobSystem& jobs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        m_Stats = AnimationLodStats();
+        extractFrustum(viewProjection);
+
+        // levels, playback time and which characters are due this frame
+        m_Order.clear();
+        float tanHalfFov = std::tan(fovY * 0.5f);
+        for (unsigned int i = 0; i < m_Characters.size(); i++)
+        {
+            AnimatedCharacter& character = m_Characters[i];
+            if (character.Clip)
+                character.Time = std::fmod(character.Time + deltaTime * character.PlaybackRate, character.Clip->Duration);
+
+            float distance = std::max(glm::length(character.Position - cameraPosition), 1e-4f);
+            character.m_ScreenSize = character.Radius / (distance * tanHalfFov);
+            AnimationLod previous = character.Lod;
+            if (!inFrustum(character.Position, character.Radius))
+                character.Lod = ANIM_LOD_OFFSCREEN;
+            else if (character.m_ScreenSize < m_Settings.distantScreenSize)
+                character.Lod = ANIM_LOD_DISTANT;
+            else if (character.m_ScreenSize < m_Settings.reducedScreenSize)
+                character.Lod = ANIM_LOD_REDUCED;
+            else
+                character.Lod = ANIM_LOD_FULL;
+            if (character.Lod != ANIM_LOD_OFFSCREEN)
+                m_Order.push_back(i);
+
+            // coming back on screen with a stale pose forces an evaluation
+            if (previous == ANIM_LOD_OFFSCREEN && character.Lod != ANIM_LOD_OFFSCREEN)
+                character.m_Evaluated = false;
+        }
+
+        // full-detail budget goes to the largest characters on screen
+        std::sort(m_Order.begin(), m_Order.end(), [this](unsigned int a, unsigned int b) {
+            return m_Characters[a].m_ScreenSize > m_Characters[b].m_ScreenSize;
+        });
+        unsigned int full = 0;
+        for (unsigned int index : m_Order)
+        {
+            AnimatedCharacter& character = m_Characters[index];
+            if (character.Lod == ANIM_LOD_FULL && ++full > m_Settings.maxFullCharacters)
+                character.Lod = ANIM_LOD_REDUCED;
+        }
+
+        // the evaluation budget also favours the largest; the rest stay due for a later frame
+        m_Due.clear();
+        for (AnimatedCharacter& character : m_Characters)
+        {
+            m_Stats.characters[character.Lod]++;
+            character.m_FramesSinceEvaluation++;
+        }
+        for (unsigned int index : m_Order)
+        {
+            AnimatedCharacter& character = m_Characters[index];
+            bool due = !character.m_Evaluated || character.m_FramesSinceEvaluation >= m_Settings.updateInterval[character.Lod];
+            if (!due || !character.Clip)
+                continue;
+            if (m_Due.size() >= m_Settings.maxEvaluationsPerFrame)
+            {
+                m_Stats.deferred++;
+                continue;
+            }
+            m_Due.push_back(index);
+            // Clip may have been changed since Add; the sorted copy is made here, before the workers start
+            character.m_LodClip = &sortedClip(*character.Clip);
+        }
+
+        jobs.ParallelFor(static_cast<unsigned int>(m_Due.size()), [this](unsigned int i) {
+            evaluate(m_Characters[m_Due[i]], m_Due[i]);
+        });
+
+        for (unsigned int index : m_Due)
+        {
+            const AnimatedCharacter& character = m_Characters[index];
+            m_Stats.evaluations[character.Lod]++;
+            m_Stats.jointsSampled[character.Lod] += character.m_JointsSampled;
+            m_Stats.evaluationMs[character.Lod] += character.m_EvaluationMs;
+        }
+        m_Stats.totalMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    Skeleton m_Skeleton;                        // sorted by height
+    std::vector<unsigned int> m_JointOrder;     // source joint of each sorted one
+    std::vector<unsigned int> m_LiveJoints;     // by frozen height; the last entry has nothing live
+    std::vector<std::vector<int>> m_LiveAncestors;  // by frozen height, for each frozen joint
+    std::unordered_map<const SkeletonClip*, std::unique_ptr<SkeletonClip>> m_SortedClips;
+    AnimationLodSettings m_Settings;
+    std::vector<AnimatedCharacter> m_Characters;
+    std::vector<unsigned int> m_Order;
+    std::vector<unsigned int> m_Due;
+    glm::vec4 m_Planes[6];
+    AnimationLodStats m_Stats;
+
+    void evaluate(AnimatedCharacter& character, unsigned int index)
+    {
+        auto start = std::chrono::steady_clock::now();
+        unsigned int frozenHeight = m_Settings.frozenJointHeight[character.Lod];
+        // the first evaluation samples everything, so frozen joints start from a real pose
+        if (!character.m_Evaluated)
+            frozenHeight = 0;
+
+        // only the live prefix is blended (rounded up to the four joints a SIMD step takes) and
+        // goes through the hierarchy pass; frozen bones are one multiply off the cached chains
+        const unsigned int jointCount = static_cast<unsigned int>(m_Skeleton.Joints.size());
+        frozenHeight = std::min(frozenHeight, static_cast<unsigned int>(m_LiveJoints.size() - 1));
+        const unsigned int live = m_LiveJoints[frozenHeight];
+        unsigned int sampled = 0;
+        if (live > 0)
+        {
+            samplePose(*character.m_LodClip, character.Time, character.m_Pose, live);
+            sampled = std::min(jointCount, (live + 3) & ~3u);
+        }
+        // model-space matrices are scratch, shared per worker so a large crowd only keeps its poses and skinning matrices
+        static thread_local std::vector<glm::mat4> globals;
+        if (live < jointCount && character.m_FrozenLive == live)
+        {
+            poseToBoneMatrices(m_Skeleton, character.m_Pose, globals, character.BoneMatrices, live);
+            const std::vector<int>& ancestors = m_LiveAncestors[frozenHeight];
+            for (unsigned int joint = live; joint < jointCount; joint++)
+            {
+                int boneId = m_Skeleton.Joints[joint].boneId;
+                if (boneId < 0)
+                    continue;
+                const glm::mat4& frozen = character.m_FrozenBones[joint - live];
+                if (ancestors[joint - live] >= 0)
+                    multiplyMatrices(globals[ancestors[joint - live]], frozen, character.BoneMatrices[boneId]);
+                else
+                    character.BoneMatrices[boneId] = frozen;
+            }
+        }
+        else
+        {
+            // first evaluation with this many joints frozen: everything, then cache the frozen chains
+            poseToBoneMatrices(m_Skeleton, character.m_Pose, globals, character.BoneMatrices);
+            cacheFrozenBones(character, frozenHeight);
+        }
+
+        // spread characters that start together over the interval so they don't all update on the same frame
+        unsigned int interval = std::max(1u, m_Settings.updateInterval[character.Lod]);
+        character.m_FramesSinceEvaluation = character.m_Evaluated ? 0 : index % interval;
+        character.m_Evaluated = true;
+        character.m_JointsSampled = sampled;
+        character.m_EvaluationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void cacheFrozenBones(AnimatedCharacter& character, unsigned int frozenHeight)
+    {
+        const unsigned int jointCount = static_cast<unsigned int>(m_Skeleton.Joints.size());
+        const unsigned int live = m_LiveJoints[frozenHeight];
+        static thread_local std::vector<glm::mat4> chains;
+        chains.resize(jointCount - live);
+        character.m_FrozenBones.resize(jointCount - live);
+        character.m_FrozenLive = live;
+        for (unsigned int joint = live; joint < jointCount; joint++)
+        {
+            const Skeleton::Joint& sorted = m_Skeleton.Joints[joint];
+            glm::mat4 local = jointPoseMatrix(character.m_Pose.Get(joint));
+            if (sorted.parent >= static_cast<int>(live))
+                multiplyMatrices(chains[sorted.parent - live], local, chains[joint - live]);
+            else
+                chains[joint - live] = local;
+            multiplyMatrices(chains[joint - live], sorted.offset, character.m_FrozenBones[joint - live]);
+        }
+    }
+
+    // the clip with its joints in the sorted order
+    const SkeletonClip& sortedClip(const SkeletonClip& clip)
+    {
+        std::unique_ptr<SkeletonClip>& sorted = m_SortedClips[&clip];
+        if (!sorted)
+        {
+            sorted.reset(new SkeletonClip(m_Skeleton, clip.Name, clip.Duration, clip.FrameCount));
+            for (unsigned int joint = 0; joint < m_JointOrder.size(); joint++)
+            {
+                sorted->SetAnimated(joint, clip.Animated(m_JointOrder[joint]));
+                for (unsigned int frame = 0; frame < clip.FrameCount; frame++)
+                    sorted->SetKey(frame, joint, clip.Key(frame, m_JointOrder[joint]));
+            }
+        }
+        return *sorted;
+    }
+
+    // planes from the rows of the view-projection matrix, normals pointing inwards
+    void extractFrustum(const glm::mat4& m)
+    {
+        glm::vec4 row[4];
+        for (int i = 0; i < 4; i++)
+            row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+        m_Planes[0] = row[3] + row[0];
+        m_Planes[1] = row[3] - row[0];
+        m_Planes[2] = row[3] + row[1];
+        m_Planes[3] = row[3] - row[1];
+        m_Planes[4] = row[3] + row[2];
+        m_Planes[5] = row[3] - row[2];
+        for (glm::vec4& plane : m_Planes)
+            plane /= glm::length(glm::vec3(plane));
+    }
+
+    bool inFrustum(const glm::vec3& center, float radius) const
+    {
+        for (const glm::vec4& plane : m_Planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+};
+
+#endif
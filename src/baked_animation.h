@@ -0,0 +1,209 @@
+#ifndef BAKED_ANIMATION_H
+#define BAKED_ANIMATION_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/animation.h>
+#include <learnopengl/model_animation.h>
+#include <learnopengl/shader_m.h>
+
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// where a clip lives in the bone texture; times are in seconds
+struct BakedClip {
+    std::string name;
+    unsigned int firstFrame;
+    unsigned int frameCount;
+    float framesPerSecond;      // chosen so frameCount frames span the clip exactly and it loops seamlessly
+    float duration;
+};
+
+// Clips sampled at load time into one RGBA32F texture: a row per frame, three texels per bone
+// holding the top three rows of its final (skinning) matrix. An instanced vertex shader reads
+// the two frames around its own playback time and blends them, so characters drawn this way
+// cost no Animator update and no bone uniform upload on the CPU.
+class BakedAnimationTexture
+{
+public:
+    static const int TEXTURE_UNIT = 7;
+
+    unsigned int Texture = 0;
+    unsigned int BoneCount;
+    std::vector<BakedClip> Clips;
+
+    BakedAnimationTexture(Model& model)
+        : BoneCount(static_cast<unsigned int>(model.GetBoneCount()))
+    {
+    }
+
+    // samples the clip at sampleRate and appends it; returns the clip index
+    unsigned int Bake(Animation& animation, const std::string& name, float sampleRate = 30.0f)
+    {
+        BakedClip clip;
+        clip.name = name;
+        clip.duration = animation.GetDuration() / animation.GetTicksPerSecond();
+        clip.firstFrame = m_FrameCount;
+        clip.frameCount = std::max(1u, static_cast<unsigned int>(std::ceil(clip.duration * sampleRate)));
+        clip.framesPerSecond = clip.frameCount / clip.duration;
+
+        std::vector<glm::mat4> pose(BoneCount, glm::mat4(1.0f));
+        for (unsigned int frame = 0; frame < clip.frameCount; frame++)
+        {
+            float ticks = frame / clip.framesPerSecond * animation.GetTicksPerSecond();
+            samplePose(animation, &animation.GetRootNode(), glm::mat4(1.0f), ticks, pose);
+            for (const glm::mat4& bone : pose)
+                for (int row = 0; row < 3; row++)
+                    m_Rows.push_back(glm::vec4(bone[0][row], bone[1][row], bone[2][row], bone[3][row]));
+        }
+
+        m_FrameCount += clip.frameCount;
+        Clips.push_back(clip);
+        std::cout << "Baked " << name << ": " << clip.frameCount << " frames x " << BoneCount << " bones, "
+                  << clip.frameCount * BoneCount * 3 * sizeof(glm::vec4) / 1024 << " KB" << std::endl;
+        return static_cast<unsigned int>(Clips.size() - 1);
+    }
+
+    // call once after the last Bake; the CPU copy is released, so later bakes are not possible
+    void Upload()
+    {
+        int width = static_cast<int>(BoneCount * 3);
+        int height = static_cast<int>(m_FrameCount);
+        glGenTextures(1, &Texture);
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, m_Rows.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        m_Rows.clear();
+        m_Rows.shrink_to_fit();
+    }
+
+    void Bind(Shader& shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, Texture);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("bakedBones", TEXTURE_UNIT);
+        shader.setInt("bakedBoneCount", static_cast<int>(BoneCount));
+    }
+
+private:
+    std::vector<glm::vec4> m_Rows;
+    unsigned int m_FrameCount = 0;
+
+    // same hierarchy walk as Animator::CalculateBoneTransform, at an explicit time
+    void samplePose(Animation& animation, const AssimpNodeData* node, const glm::mat4& parentTransform, float ticks,
+                    std::vector<glm::mat4>& pose)
+    {
+        glm::mat4 nodeTransform = node->transformation;
+        Bone* bone = animation.FindBone(node->name);
+        if (bone)
+        {
+            bone->Update(ticks);
+            nodeTransform = bone->GetLocalTransform();
+        }
+        glm::mat4 globalTransform = parentTransform * nodeTransform;
+
+        const std::map<std::string, BoneInfo>& boneInfoMap = animation.GetBoneIDMap();
+        auto info = boneInfoMap.find(node->name);
+        if (info != boneInfoMap.end() && info->second.id < static_cast<int>(BoneCount))
+            pose[info->second.id] = globalTransform * info->second.offset;
+
+        for (int i = 0; i < node->childrenCount; i++)
+            samplePose(animation, &node->children[i], globalTransform, ticks, pose);
+    }
+};
+
+// one background character: where it stands and what it plays
+struct CrowdInstance {
+    glm::mat4 model;
+    unsigned int clip;
+    float timeOffset;       // seconds, so a crowd playing one clip doesn't move in lockstep
+    float playbackRate;
+};
+
+// Draws any number of characters sharing a skinned mesh and a baked texture with one
+// instanced draw call per mesh. Per-instance data: model matrix (locations 7-10) and the
+// animation descriptor (location 3: first frame, frame count, frames per second, time offset).
+class InstancedCrowd
+{
+public:
+    InstancedCrowd(const std::vector<PackedMesh*>& meshes, const BakedAnimationTexture& animations)
+        : m_Meshes(meshes), m_Animations(animations)
+    {
+        glGenBuffers(1, &m_InstanceBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        for (PackedMesh* mesh : m_Meshes)
+        {
+            glBindVertexArray(mesh->VAO);
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, animation));
+            glVertexAttribDivisor(3, 1);
+            for (int column = 0; column < 4; column++)
+            {
+                glEnableVertexAttribArray(7 + column);
+                glVertexAttribPointer(7 + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData),
+                                      (void*)(offsetof(InstanceData, model) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(7 + column, 1);
+            }
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    unsigned int InstanceCount() const { return static_cast<unsigned int>(m_Instances.size()); }
+
+    // rewrites the whole instance buffer; cheap enough to do every frame for moving crowds
+    void SetInstances(const std::vector<CrowdInstance>& instances)
+    {
+        m_Instances.resize(instances.size());
+        for (size_t i = 0; i < instances.size(); i++)
+        {
+            const BakedClip& clip = m_Animations.Clips[instances[i].clip];
+            m_Instances[i].model = instances[i].model;
+            // the rate scales frames per second; the offset is in frames so the shader can add it directly
+            m_Instances[i].animation = glm::vec4(static_cast<float>(clip.firstFrame), static_cast<float>(clip.frameCount),
+                                                 clip.framesPerSecond * instances[i].playbackRate,
+                                                 instances[i].timeOffset * clip.framesPerSecond);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, m_Instances.size() * sizeof(InstanceData), m_Instances.data(), GL_STREAM_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // shader is the instanced skinning shader, already in use with view/projection set
+    void Draw(Shader& shader, float time)
+    {
+        if (m_Instances.empty())
+            return;
+        m_Animations.Bind(shader);
+        shader.setFloat("time", time);
+        for (PackedMesh* mesh : m_Meshes)
+            mesh->DrawInstanced(shader, InstanceCount());
+    }
+
+private:
+    struct InstanceData {
+        glm::vec4 animation;
+        glm::mat4 model;
+    };
+
+    std::vector<PackedMesh*> m_Meshes;
+    const BakedAnimationTexture& m_Animations;
+    unsigned int m_InstanceBuffer;
+    std::vector<InstanceData> m_Instances;
+};
+
+#endif
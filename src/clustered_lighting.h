@@ -0,0 +1,208 @@
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader_m.h>
+
+#include "job_system.h"
+#include "light_clusters.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// The lit fragment shaders' half of the cluster layout: the uniforms Bind() sets and the light
+// loop. It lives here, next to the code that packs the buffers, and is spliced into every
+// shader that includes it (see includeClusteredLighting), so there is one copy to fix.
+const char* const CLUSTERED_LIGHTING_GLSL = R"(
+uniform samplerBuffer lightData;        // 3 texels per light: position + range, color + cos outer, direction + cos inner
+uniform usamplerBuffer clusterRanges;   // per cluster: first index, light count
+uniform usamplerBuffer lightIndices;
+uniform ivec3 clusterCount;
+uniform vec2 clusterTileSize;
+uniform float clusterDepthScale;
+uniform float clusterDepthBias;
+
+const vec3 AMBIENT = vec3(0.15);
+
+vec3 shadeClusteredLights(vec3 albedo, vec3 P, vec3 N)
+{
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / clusterTileSize), int(log(-P.z) * clusterDepthScale + clusterDepthBias));
+    cluster = clamp(cluster, ivec3(0), clusterCount - 1);
+    uvec2 range = texelFetch(clusterRanges, (cluster.z * clusterCount.y + cluster.y) * clusterCount.x + cluster.x).xy;
+
+    vec3 V = normalize(-P);
+    vec3 result = AMBIENT * albedo;
+    for (uint i = 0u; i < range.y; i++)
+    {
+        int light = int(texelFetch(lightIndices, int(range.x + i)).r) * 3;
+        vec4 positionRange = texelFetch(lightData, light);
+        vec4 colorOuter = texelFetch(lightData, light + 1);
+        vec4 directionInner = texelFetch(lightData, light + 2);
+
+        vec3 L = positionRange.xyz - P;
+        float lightDistance = length(L);
+        L /= lightDistance;
+        // inverse square, windowed to reach zero at the light's range
+        float window = clamp(1.0 - pow(lightDistance / positionRange.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (lightDistance * lightDistance + 1.0);
+        float cone = smoothstep(colorOuter.w, directionInner.w, dot(-L, directionInner.xyz));
+
+        float diffuse = max(dot(N, L), 0.0);
+        float specular = pow(max(dot(N, normalize(L + V)), 0.0), 32.0) * 0.25;
+        result += (albedo * diffuse + specular) * colorOuter.rgb * attenuation * cone;
+    }
+    return result;
+}
+)";
+
+// GLSL 330 has no #include, and Shader only loads files. This reads a fragment shader, replaces
+// its #include "clustered_lighting.glsl" line with CLUSTERED_LIGHTING_GLSL, writes the result to
+// the system temp directory (not the working directory, which may be read-only or the source
+// tree) and returns that path for Shader to load.
+inline std::string includeClusteredLighting(const std::string& path)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cout << "ERROR::CLUSTERED_LIGHTING::SHADER_NOT_FOUND " << path << std::endl;
+        return path;
+    }
+    std::stringstream source;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.find("#include \"clustered_lighting.glsl\"") != std::string::npos)
+            source << "// clustered lights, spliced in from clustered_lighting.h" << CLUSTERED_LIGHTING_GLSL;
+        else
+            source << line << "\n";
+    }
+
+    std::error_code error;
+    std::filesystem::path directory = std::filesystem::temp_directory_path(error) / "learnopengl_shaders";
+    if (!error)
+        std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        std::cout << "ERROR::CLUSTERED_LIGHTING::NO_TEMP_DIRECTORY " << error.message() << std::endl;
+        return path;
+    }
+    std::string generated = (directory / (std::filesystem::path(path).filename().string() + ".generated")).string();
+    std::ofstream out(generated, std::ios::trunc);
+    out << source.str();
+    if (!out)
+    {
+        std::cout << "ERROR::CLUSTERED_LIGHTING::FAILED_TO_WRITE " << generated << std::endl;
+        return path;
+    }
+    return generated;
+}
+
+// GPU side of clustered forward lighting: uploads what LightClusterBuilder produces into three
+// texture buffers (GL 3.3 has no storage buffers) and points the lit shaders at them. The
+// fragment shaders find their cluster from gl_FragCoord and view depth and only loop over the
+// lights binned there.
+class ClusteredLighting
+{
+public:
+    // texture buffers sit above the units Mesh / PackedMesh use for material textures
+    static const int LIGHT_DATA_UNIT = 8;
+    static const int CLUSTER_RANGES_UNIT = 9;
+    static const int LIGHT_INDICES_UNIT = 10;
+
+    ClusteredLighting(const ClusterSettings& settings = ClusterSettings())
+        : m_Builder(settings)
+    {
+        m_LightData = createBuffer(GL_RGBA32F);
+        m_ClusterRanges = createBuffer(GL_RG32UI);
+        m_LightIndices = createBuffer(GL_R32UI);
+    }
+
+    const LightClusterBuilder& Builder() const { return m_Builder; }
+    const ClusterStats& Stats() const { return m_Builder.Stats(); }
+
+    // bins the lights for this frame's camera and uploads the result
+    void Update(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, JobSystem& jobs)
+    {
+        m_Builder.Build(lights, view, projection, jobs);
+        upload(m_LightData, m_Builder.LightData().data(), m_Builder.LightData().size() * sizeof(glm::vec4));
+        upload(m_ClusterRanges, m_Builder.ClusterRanges().data(), m_Builder.ClusterRanges().size() * sizeof(uint32_t));
+        upload(m_LightIndices, m_Builder.LightIndices().data(), m_Builder.LightIndices().size() * sizeof(uint32_t));
+    }
+
+    // the shader must be in use; framebuffer size is in pixels, as gl_FragCoord is
+    void Bind(Shader& shader, int framebufferWidth, int framebufferHeight) const
+    {
+        const ClusterSettings& settings = m_Builder.Settings();
+        bindBuffer(m_LightData, LIGHT_DATA_UNIT);
+        bindBuffer(m_ClusterRanges, CLUSTER_RANGES_UNIT);
+        bindBuffer(m_LightIndices, LIGHT_INDICES_UNIT);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setInt("lightData", LIGHT_DATA_UNIT);
+        shader.setInt("clusterRanges", CLUSTER_RANGES_UNIT);
+        shader.setInt("lightIndices", LIGHT_INDICES_UNIT);
+        glUniform3i(glGetUniformLocation(shader.ID, "clusterCount"), settings.tilesX, settings.tilesY, settings.slices);
+        shader.setVec2("clusterTileSize", glm::vec2(static_cast<float>(framebufferWidth) / settings.tilesX,
+                                                    static_cast<float>(framebufferHeight) / settings.tilesY));
+        shader.setFloat("clusterDepthScale", m_Builder.DepthScale());
+        shader.setFloat("clusterDepthBias", m_Builder.DepthBias());
+    }
+
+private:
+    struct TextureBuffer {
+        unsigned int buffer;
+        unsigned int texture;
+        size_t capacity;
+    };
+
+    LightClusterBuilder m_Builder;
+    TextureBuffer m_LightData;
+    TextureBuffer m_ClusterRanges;
+    TextureBuffer m_LightIndices;
+
+    static TextureBuffer createBuffer(GLenum format)
+    {
+        TextureBuffer result;
+        glGenBuffers(1, &result.buffer);
+        glGenTextures(1, &result.texture);
+        // never empty, a zero-sized buffer texture is incomplete
+        result.capacity = 16;
+        glBindBuffer(GL_TEXTURE_BUFFER, result.buffer);
+        glBufferData(GL_TEXTURE_BUFFER, result.capacity, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, result.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, result.buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        return result;
+    }
+
+    static void upload(TextureBuffer& target, const void* data, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, target.buffer);
+        if (bytes > target.capacity)
+        {
+            // grow with headroom so a rising light count does not reallocate every frame
+            target.capacity = bytes + bytes / 2;
+        }
+        // orphan the old storage so we don't wait on frames still reading it
+        glBufferData(GL_TEXTURE_BUFFER, target.capacity, nullptr, GL_STREAM_DRAW);
+        if (bytes)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    static void bindBuffer(const TextureBuffer& source, int unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, source.texture);
+    }
+};
+
+#endif
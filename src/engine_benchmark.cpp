@@ -0,0 +1,1046 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation_lod.h"
+#include "collision.h"
+#include "job_system.h"
+#include "light_clusters.h"
+#include "lod_settings.h"
+#include "mesh_simplify.h"
+#include "navigation.h"
+#include "occlusion_culling.h"
+#include "pose_blend.h"
+#include "skeleton.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Headless benchmarks for the CPU-side engine systems. None of them need a GL context or a GPU,
+// so they run anywhere, including CI machines. Pass the name of a benchmark to run only that one.
+//
+//   engine_benchmark [occlusion|lights|pose|nav|lod [mesh.obj]]
+
+int benchmarkOcclusion(JobSystem& jobs);
+int benchmarkLightClusters(JobSystem& jobs);
+int benchmarkPoseBlending(JobSystem& jobs);
+int benchmarkNavigation(JobSystem& jobs);
+int benchmarkMeshSimplify(const std::string& objPath);
+
+int main(int argc, char** argv)
+{
+    JobSystem jobs;
+    std::cout << "engine_benchmark: " << jobs.ThreadCount() << " worker threads" << std::endl;
+
+    std::string only = argc > 1 ? argv[1] : "";
+    int failures = 0;
+    if (only.empty() || only == "occlusion")
+        failures += benchmarkOcclusion(jobs);
+    if (only.empty() || only == "lights")
+        failures += benchmarkLightClusters(jobs);
+    if (only.empty() || only == "pose")
+        failures += benchmarkPoseBlending(jobs);
+    if (only.empty() || only == "nav")
+        failures += benchmarkNavigation(jobs);
+    if (only.empty() || only == "lod")
+        failures += benchmarkMeshSimplify(argc > 2 ? argv[2] : "resources/objects/rock/rock.obj");
+    return failures == 0 ? 0 : 1;
+}
+
+// occlusion culling
+// -----------------
+// A street-level view over a town: rows of walls hide most of the props scattered between them.
+// The camera turns a full circle; the culled percentage and the cost of both halves of the pass
+// are averaged over all frames.
+int benchmarkOcclusion(JobSystem& jobs)
+{
+    std::vector<AABB> walls;
+    std::vector<AABB> props;
+    const int blocks = 16;
+    const float blockSize = 12.0f;
+    for (int z = -blocks / 2; z < blocks / 2; z++)
+    {
+        for (int x = -blocks / 2; x < blocks / 2; x++)
+        {
+            glm::vec3 origin(x * blockSize, 0.0f, z * blockSize);
+            // one building per block, leaving streets of 4 units between them
+            walls.push_back(AABB{ origin + glm::vec3(2.0f, 0.0f, 2.0f), origin + glm::vec3(blockSize - 2.0f, 6.0f + (x + z + 16) % 5, blockSize - 2.0f) });
+            for (int i = 0; i < 16; i++)
+            {
+                glm::vec3 position = origin + glm::vec3(0.5f + (i % 4) * 3.0f, 0.0f, 0.5f + (i / 4) * 3.0f);
+                props.push_back(AABB{ position, position + glm::vec3(0.6f, 1.2f, 0.6f) });
+            }
+        }
+    }
+    // the buildings are drawn too, so they are tested like everything else
+    std::vector<AABB> objects = props;
+    objects.insert(objects.end(), walls.begin(), walls.end());
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::vec3 eye(0.0f, 1.7f, 0.0f);
+
+    OcclusionCuller culler;
+    std::vector<uint8_t> visible;
+    const int frames = 360;
+    double culledPercent = 0.0, occluded = 0.0, rasterizeMs = 0.0, testMs = 0.0;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        float angle = glm::radians(static_cast<float>(frame));
+        glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::sin(angle), 0.0f, -std::cos(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        culler.BeginFrame(projection * view);
+        for (const AABB& wall : walls)
+            culler.AddOccluderBox(wall);
+        culler.Rasterize(jobs);
+        culler.TestBoxes(objects, visible, jobs);
+
+        const OcclusionStats& stats = culler.Stats();
+        culledPercent += stats.CulledPercent();
+        occluded += stats.occluded;
+        rasterizeMs += stats.rasterizeMs;
+        testMs += stats.testMs;
+    }
+
+    std::cout << "occlusion: " << objects.size() << " objects, " << walls.size() * 12 << " occluder triangles, "
+              << culler.Width() << "x" << culler.Height() << " depth buffer" << std::endl;
+    std::cout << "  culled " << culledPercent / frames << "% (" << occluded / frames << " occluded per frame)" << std::endl;
+    std::cout << "  rasterize " << rasterizeMs / frames << " ms, test " << testMs / frames << " ms per frame" << std::endl;
+
+    // sanity check: a prop right behind the first building is hidden, one in the open street is not
+    glm::mat4 view = glm::lookAt(glm::vec3(6.0f, 1.7f, -6.0f), glm::vec3(6.0f, 1.7f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    culler.BeginFrame(projection * view);
+    culler.AddOccluderBox(AABB{ glm::vec3(2.0f, 0.0f, 2.0f), glm::vec3(10.0f, 6.0f, 10.0f) });
+    culler.Rasterize(jobs);
+    std::vector<AABB> probes = {
+        AABB{ glm::vec3(5.5f, 0.0f, 12.0f), glm::vec3(6.5f, 1.0f, 13.0f) },
+        AABB{ glm::vec3(5.5f, 0.0f, 0.0f), glm::vec3(6.5f, 1.0f, 1.0f) }
+    };
+    culler.TestBoxes(probes, visible, jobs);
+    if (visible[0] || !visible[1])
+    {
+        std::cout << "ERROR::OCCLUSION::SANITY_CHECK_FAILED" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// clustered lighting
+// ------------------
+// 1k, 10k and 100k point and spot lights spread over a 200 x 200 area around a camera at head
+// height. Reports the cost of binning them into the cluster grid and how evenly they land.
+int benchmarkLightClusters(JobSystem& jobs)
+{
+    unsigned int seed = 7u;
+    auto random01 = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+
+    ClusterSettings settings;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, settings.nearPlane, settings.farPlane);
+    LightClusterBuilder builder(settings);
+    int failures = 0;
+
+    for (unsigned int lightCount : { 1000u, 10000u, 100000u })
+    {
+        std::vector<Light> lights(lightCount);
+        for (Light& light : lights)
+        {
+            light.type = random01() < 0.2f ? LIGHT_SPOT : LIGHT_POINT;
+            light.position = glm::vec3(random01() * 200.0f - 100.0f, 0.5f + random01() * 4.0f, random01() * 200.0f - 100.0f);
+            light.direction = glm::normalize(glm::vec3(random01() - 0.5f, -1.0f, random01() - 0.5f));
+            light.range = 1.0f + random01() * 3.0f;
+        }
+
+        const int frames = 20;
+        double buildMs = 0.0;
+        for (int frame = 0; frame < frames; frame++)
+        {
+            float angle = glm::radians(frame * 18.0f);
+            glm::vec3 eye(0.0f, 1.7f, 0.0f);
+            glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::sin(angle), -0.1f, -std::cos(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+            builder.Build(lights, view, projection, jobs);
+            buildMs += builder.Stats().buildMs;
+        }
+
+        const ClusterStats& stats = builder.Stats();
+        std::cout << "lights: " << lightCount << " lights, " << stats.visibleLights << " visible, "
+                  << stats.indices << " cluster entries, at most " << stats.maxLightsInCluster << " per cluster, "
+                  << stats.overflowedClusters << " clusters over the cap" << std::endl;
+        std::cout << "  build " << buildMs / frames << " ms per frame" << std::endl;
+
+        // sanity check: for points inside random lights, every point light covering the point is
+        // listed in the point's cluster, unless that cluster hit the cap
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 1.7f, 0.0f), glm::vec3(0.0f, 1.6f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        builder.Build(lights, view, projection, jobs);
+        const std::vector<glm::vec4>& data = builder.LightData();
+        const std::vector<uint32_t>& ranges = builder.ClusterRanges();
+        const std::vector<uint32_t>& indices = builder.LightIndices();
+        unsigned int missing = 0;
+        for (int sample = 0; sample < 500; sample++)
+        {
+            const Light& host = lights[static_cast<unsigned int>(random01() * lightCount) % lightCount];
+            glm::vec3 world = host.position + glm::vec3(random01() - 0.5f, random01() - 0.5f, random01() - 0.5f) * host.range;
+            glm::vec3 point = glm::vec3(view * glm::vec4(world, 1.0f));
+            float depth = -point.z;
+            glm::vec2 ndc(projection[0][0] * point.x / depth, projection[1][1] * point.y / depth);
+            if (depth < settings.nearPlane || depth >= settings.farPlane || std::fabs(ndc.x) >= 1.0f || std::fabs(ndc.y) >= 1.0f)
+                continue;
+
+            int x = static_cast<int>((ndc.x * 0.5f + 0.5f) * settings.tilesX);
+            int y = static_cast<int>((ndc.y * 0.5f + 0.5f) * settings.tilesY);
+            int z = std::max(0, std::min(settings.slices - 1, static_cast<int>(std::log(depth) * builder.DepthScale() + builder.DepthBias())));
+            unsigned int cluster = (z * settings.tilesY + y) * settings.tilesX + x;
+            uint32_t first = ranges[cluster * 2], count = ranges[cluster * 2 + 1];
+            if (count == settings.maxLightsPerCluster)
+                continue;
+
+            for (const Light& light : lights)
+            {
+                if (light.type != LIGHT_POINT || glm::length(world - light.position) > light.range * 0.999f)
+                    continue;
+                glm::vec3 lightView = glm::vec3(view * glm::vec4(light.position, 1.0f));
+                bool found = false;
+                for (uint32_t j = first; j < first + count && !found; j++)
+                    found = glm::length(glm::vec3(data[indices[j] * 3]) - lightView) < 1e-3f;
+                missing += !found;
+            }
+        }
+        if (missing)
+        {
+            std::cout << "ERROR::LIGHT_CLUSTERS::SANITY_CHECK_FAILED " << missing << " lights missing from their cluster" << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// pose blending
+// -------------
+// A 55-joint humanoid skeleton playing synthetic one-second clips keyed at 30 fps. The baseline
+// restates what learnopengl's Animator does per frame (it needs assimp to load, so it can't run
+// here): a recursive node walk, a search for each node's Bone by name, linear keyframe searches,
+// a slerp and three matrix builds per joint, and a copy of the bone map per node. It is compared
+// with the per-joint SkeletonClip path and with SoA sampling, SIMD nlerp crossfades and blend
+// spaces through poseToBoneMatrices. Throughput is in bones per second on one thread, and
+// then for a crowd of crossfading characters on the job system.
+namespace
+{
+    struct ReferenceNode {
+        std::string name;
+        glm::mat4 transformation;
+        std::vector<ReferenceNode> children;
+    };
+
+    struct ReferenceBone {
+        std::string name;
+        std::vector<float> times;           // ticks, one key per frame plus a closing key
+        std::vector<glm::vec3> positions;
+        std::vector<glm::quat> rotations;
+        std::vector<glm::vec3> scales;
+        glm::mat4 localTransform;
+
+        unsigned int keyIndex(float ticks) const
+        {
+            for (unsigned int i = 0; i + 1 < times.size(); i++)
+                if (ticks < times[i + 1])
+                    return i;
+            return static_cast<unsigned int>(times.size() - 2);
+        }
+
+        void Update(float ticks)
+        {
+            unsigned int p = keyIndex(ticks), r = keyIndex(ticks), s = keyIndex(ticks);
+            float pf = (ticks - times[p]) / (times[p + 1] - times[p]);
+            float rf = (ticks - times[r]) / (times[r + 1] - times[r]);
+            float sf = (ticks - times[s]) / (times[s + 1] - times[s]);
+            glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::mix(positions[p], positions[p + 1], pf));
+            glm::mat4 rotation = glm::mat4_cast(glm::normalize(glm::slerp(rotations[r], rotations[r + 1], rf)));
+            glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::mix(scales[s], scales[s + 1], sf));
+            localTransform = translation * rotation * scale;
+        }
+    };
+
+    struct ReferenceBoneInfo {
+        int id;
+        glm::mat4 offset;
+    };
+
+    struct ReferenceAnimator {
+        ReferenceNode root;
+        std::vector<ReferenceBone> bones;
+        std::map<std::string, ReferenceBoneInfo> boneInfoMap;
+        std::vector<glm::mat4> finalBoneMatrices;
+
+        ReferenceBone* findBone(const std::string& name)
+        {
+            auto found = std::find_if(bones.begin(), bones.end(), [&name](const ReferenceBone& bone) { return bone.name == name; });
+            return found == bones.end() ? nullptr : &*found;
+        }
+
+        void calculateBoneTransform(const ReferenceNode* node, const glm::mat4& parentTransform, float ticks)
+        {
+            std::string nodeName = node->name;
+            glm::mat4 nodeTransform = node->transformation;
+            ReferenceBone* bone = findBone(nodeName);
+            if (bone)
+            {
+                bone->Update(ticks);
+                nodeTransform = bone->localTransform;
+            }
+            glm::mat4 globalTransformation = parentTransform * nodeTransform;
+            auto boneInfo = boneInfoMap;
+            if (boneInfo.find(nodeName) != boneInfo.end())
+                finalBoneMatrices[boneInfo[nodeName].id] = globalTransformation * boneInfo[nodeName].offset;
+            for (const ReferenceNode& child : node->children)
+                calculateBoneTransform(&child, globalTransformation, ticks);
+        }
+    };
+
+    // hips, spine, neck and head, then per side an arm with five three-joint fingers and a leg
+    void buildHumanoid(Skeleton& skeleton)
+    {
+        auto offsetOf = [](unsigned int depth) { return glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.1f * depth, 0.0f)); };
+        auto add = [&](const std::string& name, int parent, glm::vec3 offset) {
+            int depth = 0;
+            for (int p = parent; p >= 0; p = skeleton.Joints[p].parent)
+                depth++;
+            int id = static_cast<int>(skeleton.Joints.size());
+            return static_cast<int>(skeleton.AddJoint(name, parent, id, offsetOf(depth), glm::translate(glm::mat4(1.0f), offset)));
+        };
+        int hips = add("Hips", -1, glm::vec3(0.0f, 1.0f, 0.0f));
+        int spine = hips;
+        for (int i = 0; i < 3; i++)
+            spine = add("Spine" + std::to_string(i), spine, glm::vec3(0.0f, 0.12f, 0.0f));
+        int head = add("Head", add("Neck", spine, glm::vec3(0.0f, 0.1f, 0.0f)), glm::vec3(0.0f, 0.1f, 0.0f));
+        add("HeadTop_End", head, glm::vec3(0.0f, 0.15f, 0.0f));
+        for (int side = 0; side < 2; side++)
+        {
+            float x = side == 0 ? -1.0f : 1.0f;
+            std::string prefix = side == 0 ? "Left" : "Right";
+            int arm = add(prefix + "Shoulder", spine, glm::vec3(0.08f * x, 0.08f, 0.0f));
+            arm = add(prefix + "Arm", arm, glm::vec3(0.12f * x, 0.0f, 0.0f));
+            arm = add(prefix + "ForeArm", arm, glm::vec3(0.25f * x, 0.0f, 0.0f));
+            int hand = add(prefix + "Hand", arm, glm::vec3(0.25f * x, 0.0f, 0.0f));
+            for (int finger = 0; finger < 5; finger++)
+            {
+                int joint = hand;
+                for (int segment = 0; segment < 3; segment++)
+                    joint = add(prefix + "Finger" + std::to_string(finger) + "_" + std::to_string(segment), joint,
+                                glm::vec3(0.03f * x, 0.0f, 0.02f * (finger - 2)));
+            }
+            int leg = add(prefix + "UpLeg", hips, glm::vec3(0.1f * x, -0.05f, 0.0f));
+            leg = add(prefix + "Leg", leg, glm::vec3(0.0f, -0.45f, 0.0f));
+            leg = add(prefix + "Foot", leg, glm::vec3(0.0f, -0.45f, 0.0f));
+            leg = add(prefix + "ToeBase", leg, glm::vec3(0.0f, -0.05f, 0.1f));
+            add(prefix + "Toe_End", leg, glm::vec3(0.0f, 0.0f, 0.05f));
+        }
+        skeleton.Finalize();
+    }
+
+    // every joint swings about its own axis, out of phase with the others
+    JointPose syntheticKey(const Skeleton& skeleton, unsigned int joint, float phase, float amplitude)
+    {
+        JointPose pose;
+        pose.translation = glm::vec3(skeleton.Joints[joint].bindLocal[3]);
+        glm::vec3 axis = glm::normalize(glm::vec3(std::sin(joint * 1.3f), std::cos(joint * 0.7f), 0.5f));
+        pose.rotation = glm::angleAxis(amplitude * std::sin(glm::radians(360.0f) * phase + joint * 0.4f), axis);
+        return pose;
+    }
+
+    SkeletonClip makeClip(const Skeleton& skeleton, const std::string& name, float duration, float amplitude)
+    {
+        const unsigned int frames = static_cast<unsigned int>(duration * 30.0f);
+        SkeletonClip clip(skeleton, name, duration, frames);
+        for (unsigned int joint = 0; joint < skeleton.Joints.size(); joint++)
+        {
+            clip.SetAnimated(joint, true);
+            for (unsigned int frame = 0; frame < frames; frame++)
+                clip.SetKey(frame, joint, syntheticKey(skeleton, joint, static_cast<float>(frame) / frames, amplitude));
+        }
+        return clip;
+    }
+
+    ReferenceNode buildNode(const Skeleton& skeleton, unsigned int joint)
+    {
+        ReferenceNode node;
+        node.name = skeleton.Joints[joint].name;
+        node.transformation = skeleton.Joints[joint].bindLocal;
+        for (unsigned int child = joint + 1; child < skeleton.Joints.size(); child++)
+            if (skeleton.Joints[child].parent == static_cast<int>(joint))
+                node.children.push_back(buildNode(skeleton, child));
+        return node;
+    }
+
+    // the same clip in the Animator's layout: a node tree and one keyed Bone per joint, times in ticks at 30 per second
+    void buildReference(const Skeleton& skeleton, const SkeletonClip& clip, ReferenceAnimator& animator)
+    {
+        animator.root = buildNode(skeleton, 0);
+        for (unsigned int i = 0; i < skeleton.Joints.size(); i++)
+        {
+            const Skeleton::Joint& joint = skeleton.Joints[i];
+            animator.boneInfoMap[joint.name] = ReferenceBoneInfo{ joint.boneId, joint.offset };
+
+            ReferenceBone bone;
+            bone.name = joint.name;
+            for (unsigned int frame = 0; frame <= clip.FrameCount; frame++)
+            {
+                JointPose key = clip.Key(frame % clip.FrameCount, i);
+                bone.times.push_back(static_cast<float>(frame));
+                bone.positions.push_back(key.translation);
+                bone.rotations.push_back(key.rotation);
+                bone.scales.push_back(key.scale);
+            }
+            animator.bones.push_back(bone);
+        }
+        animator.finalBoneMatrices.assign(100, glm::mat4(1.0f));
+    }
+
+    float maxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b, unsigned int count)
+    {
+        float difference = 0.0f;
+        for (unsigned int i = 0; i < count; i++)
+            for (int column = 0; column < 4; column++)
+                for (int row = 0; row < 4; row++)
+                    difference = std::max(difference, std::fabs(a[i][column][row] - b[i][column][row]));
+        return difference;
+    }
+
+    double secondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int benchmarkPoseBlending(JobSystem& jobs)
+{
+    Skeleton skeleton;
+    buildHumanoid(skeleton);
+    const unsigned int joints = static_cast<unsigned int>(skeleton.Joints.size());
+    SkeletonClip walk = makeClip(skeleton, "walk", 1.0f, 0.6f);
+    SkeletonClip stand = makeClip(skeleton, "stand", 2.0f, 0.1f);
+    SkeletonClip run = makeClip(skeleton, "run", 0.7f, 0.9f);
+
+    ReferenceAnimator reference;
+    buildReference(skeleton, walk, reference);
+
+    const unsigned int evaluations = 20000;
+    const float step = 1.0f / 60.0f;
+    auto report = [&](const char* name, double seconds, unsigned int count) {
+        std::cout << "  " << name << ": " << seconds / count * 1e6 << " us per character, "
+                  << static_cast<double>(count) * joints / seconds / 1e6 << " M bones/s" << std::endl;
+    };
+    std::cout << "pose: " << joints << " joints, clips of " << walk.FrameCount << ", " << stand.FrameCount << " and "
+              << run.FrameCount << " frames" << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < evaluations; i++)
+        reference.calculateBoneTransform(&reference.root, glm::mat4(1.0f), std::fmod(i * step * 30.0f, 30.0f));
+    report("Animator (recursive, per-node lookups)", secondsSince(start), evaluations);
+
+    std::vector<glm::mat4> locals(joints), globals, boneMatrices;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < evaluations; i++)
+    {
+        unsigned int frame0, frame1;
+        float blend;
+        walk.FramesAt(i * step, frame0, frame1, blend);
+        for (unsigned int joint = 0; joint < joints; joint++)
+            locals[joint] = jointPoseMatrix(walk.Sample(joint, frame0, frame1, blend));
+        skeleton.ComputeBoneMatrices(locals, globals, boneMatrices);
+    }
+    report("per-joint slerp, flat hierarchy", secondsSince(start), evaluations);
+
+    PoseBuffer pose, scratch;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < evaluations; i++)
+    {
+        samplePose(walk, i * step, pose);
+        poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+    }
+    report("SoA nlerp, one clip", secondsSince(start), evaluations);
+
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < evaluations; i++)
+    {
+        samplePose(stand, i * step, pose);
+        samplePose(walk, i * step, scratch);
+        blendPoses(pose, scratch, (i % 60) / 60.0f, pose);
+        poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+    }
+    report("SoA nlerp, crossfade of two clips", secondsSince(start), evaluations);
+
+    BlendSpace1D locomotion;
+    locomotion.Add(&stand, 0.0f);
+    locomotion.Add(&walk, 1.0f);
+    locomotion.Add(&run, 2.0f);
+    float phase = 0.0f;
+    start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < evaluations; i++)
+    {
+        float speed = 1.0f + std::sin(i * 0.01f);
+        phase = std::fmod(phase + step / locomotion.Duration(speed), 1.0f);
+        locomotion.Sample(speed, phase, pose);
+        poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+    }
+    report("SoA nlerp, stand/walk/run blend space", secondsSince(start), evaluations);
+
+    // a crowd where everyone is mid-crossfade, spread over the workers
+    const unsigned int crowdSize = 2000, crowdFrames = 30;
+    std::vector<PoseAnimator> crowd;
+    crowd.reserve(crowdSize);
+    for (unsigned int i = 0; i < crowdSize; i++)
+        crowd.emplace_back(skeleton, i % 2 ? &walk : &stand);
+    start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < crowdFrames; frame++)
+    {
+        jobs.ParallelFor(crowdSize, [&](unsigned int i) {
+            if (frame % 10 == 0)
+                crowd[i].PlayAnimation(crowd[i].GetCurrentAnimation() == &walk ? &stand : &walk, 0.25f);
+            crowd[i].UpdateAnimation(step);
+        });
+    }
+    double crowdSeconds = secondsSince(start);
+    std::cout << "  crowd of " << crowdSize << " crossfading characters: " << crowdSeconds / crowdFrames * 1000.0 << " ms per frame, "
+              << static_cast<double>(crowdSize) * crowdFrames * joints / crowdSeconds / 1e6 << " M bones/s" << std::endl;
+
+    // the same crowd through AnimationLodSystem, spread from near the camera to far away so every
+    // level is in use; no evaluation cap, so the cost is what the levels alone save
+    AnimationLodSettings lodSettings;
+    lodSettings.maxEvaluationsPerFrame = crowdSize;
+    AnimationLodSystem lodCrowd(skeleton, lodSettings);
+    for (unsigned int i = 0; i < crowdSize; i++)
+        lodCrowd.Add(i % 2 ? &walk : &stand, glm::vec3((i % 40) * 1.5f - 30.0f, 0.0f, -2.0f - (i / 40) * 1.5f), 1.0f);
+    glm::mat4 lodViewProjection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+    unsigned long long lodEvaluations = 0;
+    unsigned long long levelEvaluations[ANIM_LOD_COUNT] = {}, levelJoints[ANIM_LOD_COUNT] = {};
+    double levelMs[ANIM_LOD_COUNT] = {};
+    start = std::chrono::steady_clock::now();
+    for (unsigned int frame = 0; frame < crowdFrames; frame++)
+    {
+        lodCrowd.Update(step, lodViewProjection, glm::vec3(0.0f), glm::radians(60.0f), jobs);
+        for (unsigned int level = 0; level < ANIM_LOD_COUNT; level++)
+        {
+            lodEvaluations += lodCrowd.Stats().evaluations[level];
+            levelEvaluations[level] += lodCrowd.Stats().evaluations[level];
+            levelJoints[level] += lodCrowd.Stats().jointsSampled[level];
+            levelMs[level] += lodCrowd.Stats().evaluationMs[level];
+        }
+    }
+    double lodSeconds = secondsSince(start);
+    const AnimationLodStats& lodStats = lodCrowd.Stats();
+    std::cout << "  LOD crowd of " << crowdSize << " (full/reduced/distant/offscreen " << lodStats.characters[ANIM_LOD_FULL] << "/"
+              << lodStats.characters[ANIM_LOD_REDUCED] << "/" << lodStats.characters[ANIM_LOD_DISTANT] << "/"
+              << lodStats.characters[ANIM_LOD_OFFSCREEN] << "): " << lodSeconds / crowdFrames * 1000.0 << " ms per frame, "
+              << lodSeconds / std::max(1ull, lodEvaluations) * 1e6 << " us per evaluation" << std::endl;
+    const char* levelNames[] = { "full", "reduced", "distant" };
+    for (unsigned int level = 0; level < ANIM_LOD_OFFSCREEN; level++)
+        if (levelEvaluations[level] > 0)
+            std::cout << "    " << levelNames[level] << ": " << levelMs[level] * 1000.0 / levelEvaluations[level] << " us and "
+                      << levelJoints[level] / levelEvaluations[level] << " joints sampled per evaluation" << std::endl;
+
+    // sanity check: the SoA path matches the Animator within nlerp error, and a crossfade at
+    // weight 0 is exactly the clip it starts from
+    int failures = 0;
+    float worst = 0.0f;
+    for (unsigned int i = 0; i < 120; i++)
+    {
+        float time = i * 0.0137f;
+        reference.calculateBoneTransform(&reference.root, glm::mat4(1.0f), std::fmod(time * 30.0f, 30.0f));
+        samplePose(walk, time, pose);
+        poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+        worst = std::max(worst, maxDifference(reference.finalBoneMatrices, boneMatrices, skeleton.BoneCount));
+    }
+    samplePose(walk, 0.3f, pose);
+    samplePose(stand, 0.3f, scratch);
+    PoseBuffer blended;
+    blendPoses(pose, scratch, 0.0f, blended);
+    std::vector<glm::mat4> blendedMatrices;
+    poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+    poseToBoneMatrices(skeleton, blended, globals, blendedMatrices);
+    float crossfadeError = maxDifference(boneMatrices, blendedMatrices, skeleton.BoneCount);
+    if (worst > 1e-3f || crossfadeError > 1e-5f)
+    {
+        std::cout << "ERROR::POSE_BLEND::SANITY_CHECK_FAILED " << worst << " from the Animator, " << crossfadeError
+                  << " at crossfade weight 0" << std::endl;
+        failures++;
+    }
+
+    // the LOD system samples with its joints sorted by height; at full detail it must give the same matrices
+    AnimationLodSystem lodCheck(skeleton);
+    AnimatedCharacter& checked = lodCheck.Character(lodCheck.Add(&walk, glm::vec3(0.0f, 0.0f, -5.0f), 1.0f));
+    lodCheck.Update(0.3f, lodViewProjection, glm::vec3(0.0f), glm::radians(60.0f), jobs);
+    samplePose(walk, checked.Time, pose);
+    poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+    float lodError = checked.Evaluated() ? maxDifference(boneMatrices, checked.BoneMatrices, skeleton.BoneCount) : 1.0f;
+    if (lodError > 1e-5f)
+    {
+        std::cout << "ERROR::ANIMATION_LOD::SANITY_CHECK_FAILED " << lodError << " from the unsorted pose" << std::endl;
+        failures++;
+    }
+    // frozen joints come off cached chains from the third evaluation on; with the clock stopped the
+    // frozen pose is the sampled one, so the matrices must still match
+    AnimationLodSettings frozenSettings;
+    frozenSettings.reducedScreenSize = 100.0f;
+    frozenSettings.distantScreenSize = 0.0f;
+    frozenSettings.maxFullCharacters = 0;
+    frozenSettings.updateInterval[ANIM_LOD_REDUCED] = 1;
+    frozenSettings.frozenJointHeight[ANIM_LOD_REDUCED] = 2;
+    AnimationLodSystem frozenCheck(skeleton, frozenSettings);
+    AnimatedCharacter& frozen = frozenCheck.Character(frozenCheck.Add(&walk, glm::vec3(0.0f, 0.0f, -5.0f), 1.0f));
+    frozenCheck.Update(0.3f, lodViewProjection, glm::vec3(0.0f), glm::radians(60.0f), jobs);
+    for (int frame = 0; frame < 2; frame++)
+        frozenCheck.Update(0.0f, lodViewProjection, glm::vec3(0.0f), glm::radians(60.0f), jobs);
+    samplePose(walk, frozen.Time, pose);
+    poseToBoneMatrices(skeleton, pose, globals, boneMatrices);
+    float frozenError = frozen.Lod == ANIM_LOD_REDUCED ? maxDifference(boneMatrices, frozen.BoneMatrices, skeleton.BoneCount) : 1.0f;
+    if (frozenError > 1e-5f)
+    {
+        std::cout << "ERROR::ANIMATION_LOD::SANITY_CHECK_FAILED " << frozenError << " with frozen joints" << std::endl;
+        failures++;
+    }
+    return failures;
+}
+
+// navigation
+// ----------
+// Generated towns of 512 x 512 and 1024 x 1024 m at half-metre cells (1M and 4M cells): blocks of
+// buildings, scattered props, and long walls with a few gaps that force detours. Reports the
+// build cost and memory of the hierarchical graph, single-threaded query throughput for short
+// (agent-scale) and map-wide trips, and a crowd's worth of requests drained through
+// PathRequestQueue at a fixed budget per frame. A plain A* over the whole grid is the baseline.
+namespace
+{
+    void generateTown(float size, unsigned int seed, const NavigationSettings& settings, NavigationGrid& grid)
+    {
+        auto random01 = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+        };
+        auto box = [](float x, float z, float width, float depth, float height) {
+            return AABB{ glm::vec3(x, 0.0f, z), glm::vec3(x + width, height, z + depth) };
+        };
+
+        grid.Reset(glm::vec2(0.0f), glm::vec2(size), settings.cellSize, 0.0f);
+        grid.AddGround(box(0.0f, 0.0f, size, size, 0.0f));
+        for (float z = 0.0f; z < size; z += 32.0f)
+            for (float x = 0.0f; x < size; x += 32.0f)
+            {
+                if (random01() < 0.6f)
+                    grid.AddObstacle(box(x + 4.0f + random01() * 4.0f, z + 4.0f + random01() * 4.0f, 10.0f + random01() * 14.0f,
+                                         10.0f + random01() * 14.0f, 6.0f), settings);
+                for (int prop = 0; prop < 6; prop++)
+                    grid.AddObstacle(box(x + random01() * 32.0f, z + random01() * 32.0f, 0.5f + random01() * 1.5f, 0.5f + random01() * 1.5f,
+                                         random01() < 0.2f ? 0.2f : 1.0f), settings);
+            }
+        // walls across the whole map with a gap every 150 m or so
+        for (float z = 100.0f; z < size - 50.0f; z += 128.0f)
+            for (float x = 0.0f; x < size; x += 150.0f)
+                grid.AddObstacle(box(x + 6.0f, z, 144.0f, 1.0f, 3.0f), settings);
+    }
+
+    // plain A* over every cell, same moves and costs as the pathfinder's cell searches
+    float flatPathCost(const NavigationGrid& grid, glm::ivec2 start, glm::ivec2 goal, std::vector<float>& cost, std::vector<uint32_t>& stamp, uint32_t generation)
+    {
+        auto octile = [](int dx, int dz) {
+            dx = std::abs(dx);
+            dz = std::abs(dz);
+            return static_cast<float>(dx + dz) + (1.41421356f - 2.0f) * std::min(dx, dz);
+        };
+        std::vector<PathScratch::OpenEntry> open;
+        uint32_t first = static_cast<uint32_t>(start.y * grid.Width + start.x);
+        cost[first] = 0.0f;
+        stamp[first] = generation;
+        open.push_back(PathScratch::OpenEntry{ octile(goal.x - start.x, goal.y - start.y), 0.0f, first });
+        while (!open.empty())
+        {
+            std::pop_heap(open.begin(), open.end(), std::greater<PathScratch::OpenEntry>());
+            PathScratch::OpenEntry entry = open.back();
+            open.pop_back();
+            if (entry.g > cost[entry.index])
+                continue;
+            int x = static_cast<int>(entry.index % grid.Width), z = static_cast<int>(entry.index / grid.Width);
+            if (x == goal.x && z == goal.y)
+                return entry.g;
+            for (int dz = -1; dz <= 1; dz++)
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    if ((dx == 0 && dz == 0) || !grid.IsWalkable(x + dx, z + dz))
+                        continue;
+                    if (dx != 0 && dz != 0 && (!grid.IsWalkable(x + dx, z) || !grid.IsWalkable(x, z + dz)))
+                        continue;
+                    float g = entry.g + (dx != 0 && dz != 0 ? 1.41421356f : 1.0f);
+                    uint32_t next = static_cast<uint32_t>((z + dz) * grid.Width + x + dx);
+                    if (stamp[next] == generation && g >= cost[next])
+                        continue;
+                    stamp[next] = generation;
+                    cost[next] = g;
+                    open.push_back(PathScratch::OpenEntry{ g + octile(goal.x - x - dx, goal.y - z - dz), g, next });
+                    std::push_heap(open.begin(), open.end(), std::greater<PathScratch::OpenEntry>());
+                }
+        }
+        return -1.0f;
+    }
+
+    // false if any stretch between waypoints crosses a blocked cell
+    bool pathWalkable(const NavigationGrid& grid, const glm::vec3& start, const std::vector<glm::vec3>& waypoints)
+    {
+        glm::vec3 from = start;
+        for (const glm::vec3& to : waypoints)
+        {
+            int steps = static_cast<int>(std::ceil(glm::length(to - from) / grid.CellSize * 4.0f));
+            for (int i = 1; i < steps; i++)
+            {
+                glm::ivec2 cell = grid.CellAt(from + (to - from) * (static_cast<float>(i) / steps));
+                if (!grid.IsWalkable(cell.x, cell.y))
+                    return false;
+            }
+            from = to;
+        }
+        return true;
+    }
+}
+
+int benchmarkNavigation(JobSystem& jobs)
+{
+    unsigned int seed = 31u;
+    auto random01 = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+    NavigationSettings settings;
+    settings.cellSize = 0.5f;
+    int failures = 0;
+
+    for (float size : { 512.0f, 1024.0f })
+    {
+        NavigationGrid grid;
+        generateTown(size, 5u, settings, grid);
+        HierarchicalPathfinder pathfinder(grid, settings);
+        pathfinder.Build(jobs);
+        const NavigationStats& stats = pathfinder.Stats();
+        std::cout << "nav: " << stats.width << " x " << stats.height << " cells, " << stats.walkableCells * 100.0 / (static_cast<double>(stats.width) * stats.height)
+                  << "% walkable, " << stats.clusters << " clusters, " << stats.nodes << " nodes, " << stats.edges << " edges" << std::endl;
+        std::cout << "  build " << stats.buildMs << " ms; grid " << stats.gridBytes / 1024.0 / 1024.0 << " MB, graph "
+                  << stats.graphBytes / 1024.0 / 1024.0 << " MB" << std::endl;
+
+        auto randomPoint = [&]() {
+            for (;;)
+            {
+                glm::vec3 point(random01() * size, 0.0f, random01() * size);
+                glm::ivec2 cell = grid.CellAt(point);
+                if (grid.IsWalkable(cell.x, cell.y))
+                    return point;
+            }
+        };
+        auto nearbyPoint = [&](const glm::vec3& from) {
+            for (;;)
+            {
+                glm::vec3 point = from + glm::vec3(random01() - 0.5f, 0.0f, random01() - 0.5f) * 60.0f;
+                glm::ivec2 cell = grid.CellAt(point);
+                if (grid.IsWalkable(cell.x, cell.y))
+                    return point;
+            }
+        };
+
+        const unsigned int queryCount = 2000;
+        std::vector<glm::vec3> starts(queryCount), shortGoals(queryCount), longGoals(queryCount);
+        for (unsigned int i = 0; i < queryCount; i++)
+        {
+            starts[i] = randomPoint();
+            shortGoals[i] = nearbyPoint(starts[i]);
+            longGoals[i] = randomPoint();
+        }
+
+        PathScratch scratch;
+        std::vector<glm::vec3> waypoints;
+        for (int trip = 0; trip < 2; trip++)
+        {
+            const std::vector<glm::vec3>& goals = trip == 0 ? shortGoals : longGoals;
+            unsigned long long expanded = scratch.expanded;
+            unsigned int found = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < queryCount; i++)
+                found += pathfinder.FindPath(starts[i], goals[i], scratch, waypoints);
+            double seconds = secondsSince(start);
+            std::cout << "  " << (trip == 0 ? "short trips (< 30 m)" : "map-wide trips") << ": " << queryCount / seconds << " queries/s on one thread, "
+                      << (scratch.expanded - expanded) / queryCount << " nodes expanded per query, " << found << "/" << queryCount << " found" << std::endl;
+        }
+
+        // the baseline on a sample of the same map-wide trips
+        const unsigned int flatCount = 100;
+        std::vector<float> cost(grid.Walkable.size());
+        std::vector<uint32_t> stamp(grid.Walkable.size(), 0);
+        std::vector<float> flatCosts(flatCount);
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < flatCount; i++)
+            flatCosts[i] = flatPathCost(grid, grid.CellAt(starts[i]), grid.CellAt(longGoals[i]), cost, stamp, i + 1);
+        std::cout << "  plain A* on map-wide trips: " << flatCount / secondsSince(start) << " queries/s on one thread" << std::endl;
+
+        // the longest step a search takes between clock reads: with a deadline already past, every
+        // call stops at its first check, so each one is a single step
+        float longestStepMs = 0.0f;
+        for (unsigned int i = 0; i < flatCount; i++)
+        {
+            auto stepStart = std::chrono::steady_clock::now();
+            PathStatus status = pathfinder.StartPath(starts[i], longGoals[i], scratch, waypoints, stepStart);
+            for (;;)
+            {
+                auto stepEnd = std::chrono::steady_clock::now();
+                longestStepMs = std::max(longestStepMs, std::chrono::duration<float, std::milli>(stepEnd - stepStart).count());
+                if (status != PATH_PENDING)
+                    break;
+                stepStart = stepEnd;
+                status = pathfinder.ContinuePath(scratch, waypoints, stepStart);
+            }
+        }
+        std::cout << "  longest search step between deadline checks: " << longestStepMs << " ms" << std::endl;
+
+        // a crowd asking for paths all at once, answered at 2 ms per frame
+        const unsigned int crowd = 20000;
+        const float budgetMs = 2.0f;
+        PathRequestQueue queue(pathfinder);
+        std::vector<unsigned int> handles(crowd);
+        for (unsigned int i = 0; i < crowd; i++)
+            handles[i] = queue.Request(starts[i % queryCount], i % 4 == 0 ? longGoals[(i * 7) % queryCount] : shortGoals[i % queryCount]);
+        std::vector<float> frameMs;
+        double busyMs = 0.0;
+        do
+        {
+            queue.Update(jobs, budgetMs);
+            frameMs.push_back(queue.Stats().updateMs);
+            busyMs += queue.Stats().updateMs;
+        } while (queue.Stats().pending > 0);
+        std::sort(frameMs.begin(), frameMs.end());
+        std::cout << "  " << crowd << " requests (a quarter map-wide) at " << budgetMs << " ms per frame: " << frameMs.size() << " frames, "
+                  << crowd / (busyMs / 1000.0) << " queries/s on " << jobs.ThreadCount() + 1 << " threads, 99th percentile frame "
+                  << frameMs[frameMs.size() * 99 / 100] << " ms, worst " << frameMs.back() << " ms" << std::endl;
+        // a frame may run one step past its budget; more than that on most frames means the
+        // budget isn't being kept. With more threads than cores a worker can be switched out
+        // mid-step and finish late, so there the budget can't be promised at all
+        const unsigned int cores = std::thread::hardware_concurrency();
+        if (cores > 0 && jobs.ThreadCount() + 1 > cores)
+        {
+            std::cout << "WARNING::NAVIGATION::OVERSUBSCRIBED " << jobs.ThreadCount() + 1 << " threads on " << cores
+                      << " cores, frame budget not checked" << std::endl;
+        }
+        else if (frameMs[frameMs.size() * 99 / 100] > budgetMs + longestStepMs)
+        {
+            std::cout << "ERROR::NAVIGATION::OVER_BUDGET 99th percentile frame " << frameMs[frameMs.size() * 99 / 100] << " ms against "
+                      << budgetMs << " ms plus a " << longestStepMs << " ms step" << std::endl;
+            failures++;
+        }
+
+        // sanity check: the hierarchical search finds a path exactly when plain A* does, its
+        // paths never cross a blocked cell, and they're close to the shortest
+        unsigned int disagreements = 0, blocked = 0;
+        double ratioSum = 0.0, worstRatio = 0.0;
+        unsigned int compared = 0;
+        for (unsigned int i = 0; i < flatCount; i++)
+        {
+            bool found = pathfinder.FindPath(starts[i], longGoals[i], scratch, waypoints);
+            if (found != (flatCosts[i] >= 0.0f))
+            {
+                disagreements++;
+                continue;
+            }
+            if (!found)
+                continue;
+            if (!pathWalkable(grid, starts[i], waypoints))
+                blocked++;
+            double length = 0.0;
+            glm::vec3 from = starts[i];
+            for (const glm::vec3& to : waypoints)
+            {
+                length += glm::length(to - from);
+                from = to;
+            }
+            double ratio = length / settings.cellSize / std::max(1.0f, flatCosts[i]);
+            ratioSum += ratio;
+            worstRatio = std::max(worstRatio, ratio);
+            compared++;
+        }
+        for (unsigned int handle : handles)
+            if (queue.Status(handle) == PATH_PENDING)
+                blocked++;
+        double meanRatio = compared ? ratioSum / compared : 0.0;
+        std::cout << "  path length vs plain A*: " << meanRatio << " mean, " << worstRatio << " worst" << std::endl;
+        if (disagreements || blocked || meanRatio > 1.1 || worstRatio > 1.5)
+        {
+            std::cout << "ERROR::NAVIGATION::SANITY_CHECK_FAILED " << disagreements << " disagreements with plain A*, " << blocked
+                      << " blocked or unanswered paths, length ratio " << meanRatio << std::endl;
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// mesh simplification
+// -------------------
+// The LOD chain of an OBJ mesh, rock.obj by default, loaded the way learnopengl's assimp import
+// delivers it: every face corner is its own vertex, and normals are smoothed across corners at
+// the same position. Without the file, a lumpy UV-mapped sphere of the same kind stands in. The
+// levels use LodSettings' default ratios and errors; the check is that the coarsest level is
+// meaningfully smaller than the source, which it can't be if duplicated corners lock the mesh.
+struct SimplifyInput {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned int> indices;
+};
+
+static void smoothNormals(SimplifyInput& mesh)
+{
+    std::map<std::tuple<float, float, float>, glm::vec3> sums;
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+    {
+        const glm::vec3& p0 = mesh.positions[mesh.indices[t]];
+        glm::vec3 n = glm::cross(mesh.positions[mesh.indices[t + 1]] - p0, mesh.positions[mesh.indices[t + 2]] - p0);
+        for (int c = 0; c < 3; c++)
+        {
+            const glm::vec3& p = mesh.positions[mesh.indices[t + c]];
+            sums[std::make_tuple(p.x, p.y, p.z)] += n;
+        }
+    }
+    mesh.normals.resize(mesh.positions.size());
+    for (size_t v = 0; v < mesh.positions.size(); v++)
+    {
+        glm::vec3 sum = sums[std::make_tuple(mesh.positions[v].x, mesh.positions[v].y, mesh.positions[v].z)];
+        mesh.normals[v] = glm::dot(sum, sum) > 0.0f ? glm::normalize(sum) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+}
+
+static bool loadObj(const std::string& path, SimplifyInput& mesh)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    std::vector<glm::vec3> positions, normals;
+    std::vector<glm::vec2> uvs;
+    bool fileNormals = true;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream tokens(line);
+        std::string type;
+        tokens >> type;
+        if (type == "v")
+        {
+            glm::vec3 p;
+            tokens >> p.x >> p.y >> p.z;
+            positions.push_back(p);
+        }
+        else if (type == "vt")
+        {
+            glm::vec2 uv;
+            tokens >> uv.x >> uv.y;
+            uvs.push_back(uv);
+        }
+        else if (type == "vn")
+        {
+            glm::vec3 n;
+            tokens >> n.x >> n.y >> n.z;
+            normals.push_back(n);
+        }
+        else if (type == "f")
+        {
+            // position/uv/normal, 1-based or negative; polygons become fans
+            std::vector<unsigned int> face;
+            std::string corner;
+            while (tokens >> corner)
+            {
+                int index[3] = { 0, 0, 0 };
+                std::istringstream parts(corner);
+                std::string part;
+                for (int i = 0; i < 3 && std::getline(parts, part, '/'); i++)
+                    index[i] = part.empty() ? 0 : std::atoi(part.c_str());
+                auto resolve = [](int i, size_t count) { return i > 0 ? i - 1 : static_cast<int>(count) + i; };
+                int pi = resolve(index[0], positions.size()), ti = resolve(index[1], uvs.size()), ni = resolve(index[2], normals.size());
+                if (pi < 0 || pi >= static_cast<int>(positions.size()))
+                    return false;
+                mesh.positions.push_back(positions[pi]);
+                mesh.uvs.push_back(index[1] && ti >= 0 && ti < static_cast<int>(uvs.size()) ? uvs[ti] : glm::vec2(0.0f));
+                fileNormals = fileNormals && index[2] && ni >= 0 && ni < static_cast<int>(normals.size());
+                mesh.normals.push_back(fileNormals ? normals[ni] : glm::vec3(0.0f));
+                face.push_back(static_cast<unsigned int>(mesh.positions.size() - 1));
+            }
+            for (size_t i = 2; i < face.size(); i++)
+                mesh.indices.insert(mesh.indices.end(), { face[0], face[i - 1], face[i] });
+        }
+    }
+    if (!fileNormals)
+        smoothNormals(mesh);
+    return !mesh.indices.empty();
+}
+
+static void generateRock(SimplifyInput& mesh)
+{
+    const unsigned int rings = 64, segments = 128;
+    auto point = [](unsigned int ring, unsigned int segment) {
+        float theta = glm::pi<float>() * ring / rings, phi = 2.0f * glm::pi<float>() * (segment % segments) / segments;
+        glm::vec3 direction(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        float radius = 1.0f + 0.12f * std::sin(3.0f * direction.x + 1.0f) * std::cos(2.0f * direction.y) + 0.05f * std::sin(7.0f * direction.z);
+        return direction * radius * glm::vec3(1.0f, 0.7f, 0.9f);
+    };
+    for (unsigned int ring = 0; ring < rings; ring++)
+        for (unsigned int segment = 0; segment < segments; segment++)
+        {
+            unsigned int corners[4][2] = { { ring, segment }, { ring + 1, segment }, { ring + 1, segment + 1 }, { ring, segment + 1 } };
+            unsigned int base = static_cast<unsigned int>(mesh.positions.size());
+            for (auto& corner : corners)
+            {
+                mesh.positions.push_back(point(corner[0], corner[1]));
+                mesh.uvs.push_back(glm::vec2(static_cast<float>(corner[1]) / segments, static_cast<float>(corner[0]) / rings));
+            }
+            // the pole quads collapse to triangles
+            if (ring > 0)
+                mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 3 });
+            if (ring + 1 < rings)
+                mesh.indices.insert(mesh.indices.end(), { base + 1, base + 2, base + 3 });
+        }
+    smoothNormals(mesh);
+}
+
+int benchmarkMeshSimplify(const std::string& objPath)
+{
+    SimplifyInput mesh;
+    std::string name = objPath;
+    if (!loadObj(objPath, mesh))
+    {
+        mesh = SimplifyInput();
+        generateRock(mesh);
+        name = "generated rock (" + objPath + " not found)";
+    }
+    size_t sourceTriangles = mesh.indices.size() / 3;
+    std::cout << "lod: " << name << ", " << mesh.positions.size() << " vertices, " << sourceTriangles << " triangles" << std::endl;
+
+    const LodSettings settings;
+    size_t coarsest = sourceTriangles;
+    for (unsigned int level = 0; level < settings.triangleRatios.size(); level++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t target = static_cast<size_t>(sourceTriangles * settings.triangleRatios[level]) * 3;
+        SimplifyResult result = simplifyMesh(mesh.positions, mesh.normals, mesh.uvs, mesh.indices, target, settings.targetErrors[level]);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        size_t triangles = result.indices.size() / 3;
+        std::cout << "  level " << level + 1 << ": " << triangles << " triangles (" << triangles * 100.0 / sourceTriangles << "%), error "
+                  << result.error * 100.0f << "% of extent, " << ms << " ms" << std::endl;
+        coarsest = std::min(coarsest, triangles);
+    }
+    if (coarsest > sourceTriangles * (1.0f - settings.minReduction))
+    {
+        std::cout << "ERROR::LOD::SANITY_CHECK_FAILED coarsest level keeps " << coarsest << " of " << sourceTriangles << " triangles" << std::endl;
+        return 1;
+    }
+    return 0;
+}
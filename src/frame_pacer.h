@@ -0,0 +1,173 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+struct FramePacerSettings {
+    float targetFps = 60.0f;    // 0 runs uncapped
+    float spinMs = 1.0f;        // the end of every wait is spun rather than slept, at least this long
+    int swapInterval = 0;       // for glfwSwapInterval; 0 leaves pacing to the pacer, 1 also waits for vblank
+};
+
+// over the last whole second
+struct FramePacerStats {
+    unsigned int frames = 0;
+    unsigned int missed = 0;    // frames that were already late when they asked to wait
+    float frameMs = 0.0f;       // mean time from one frame start to the next
+    float workMs = 0.0f;        // mean time from frame start to present, what the frame itself cost
+    float sleepMs = 0.0f;       // mean per frame
+    float spinMs = 0.0f;
+    float oversleepMs = 0.0f;   // worst wake-up after the requested time
+    float spinMarginMs = 0.0f;  // what the next second's waits spin
+    float latencyMs = 0.0f;     // input sample to present
+    float latencyP99Ms = 0.0f;
+    float latencyMaxMs = 0.0f;
+};
+
+// Caps the frame rate by holding each frame back until its slot on a fixed cadence. A wait
+// sleeps until shortly before the slot and spins the rest: sleeping alone wakes up late by up
+// to the OS timer granularity, and spinning alone keeps a core busy. The spin margin follows
+// how late nine in ten wake-ups of the last second were, so it stays small on systems with fine
+// timers and a single descheduled wake-up doesn't turn the next second into a busy wait.
+// Waiting at the start of the frame, before input is read, keeps the input-to-present time
+// at the cost of one frame; the latency is measured up to when the swap call returns, which is
+// as far as the CPU can see.
+class FramePacer
+{
+public:
+    FramePacer(const FramePacerSettings& settings = FramePacerSettings())
+        : m_Settings(settings)
+    {
+    }
+
+    const FramePacerSettings& Settings() const { return m_Settings; }
+    const FramePacerStats& Stats() const { return m_Stats; }
+
+    void SetTargetFps(float fps)
+    {
+        m_Settings.targetFps = fps;
+        m_Started = false;
+    }
+
+    // call at the top of the frame, before reading input
+    void Wait()
+    {
+        Clock::time_point now = Clock::now();
+        if (m_Settings.targetFps > 0.0f)
+        {
+            Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_Settings.targetFps));
+            m_Deadline = m_Started ? m_Deadline + period : now;
+            if (now > m_Deadline)
+            {
+                m_Window.missed++;
+                // a frame or more behind: start the cadence over instead of rushing frames out to catch up
+                if (now > m_Deadline + period)
+                    m_Deadline = now;
+            }
+
+            Clock::duration margin = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(
+                std::max(m_Settings.spinMs, m_Stats.spinMarginMs)));
+            margin = std::min(margin, period / 2);
+            Clock::time_point wake = m_Deadline - margin;
+            if (now < wake)
+            {
+                std::this_thread::sleep_until(wake);
+                Clock::time_point woke = Clock::now();
+                m_Window.sleep += woke - now;
+                m_Window.oversleeps.push_back(milliseconds(woke - wake));
+                now = woke;
+            }
+            while (now < m_Deadline)
+            {
+                std::this_thread::yield();
+                Clock::time_point spun = Clock::now();
+                m_Window.spin += spun - now;
+                now = spun;
+            }
+        }
+        if (m_Started)
+        {
+            m_Window.frameTime += now - m_FrameStart;
+            m_Window.intervals++;
+        }
+        else if (m_Window.frames == 0)
+        {
+            m_WindowStart = now;
+        }
+        m_Started = true;
+        m_FrameStart = now;
+        m_Input = now;
+    }
+
+    // when this frame's input was read; a late re-sample calls it again, and the last call counts
+    void MarkInput() { m_Input = Clock::now(); }
+
+    // right after the swap
+    void MarkPresented()
+    {
+        Clock::time_point now = Clock::now();
+        m_Window.frames++;
+        m_Window.work += now - m_FrameStart;
+        m_Window.latencies.push_back(milliseconds(now - m_Input));
+        if (now - m_WindowStart >= std::chrono::seconds(1))
+            closeWindow(now);
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Window {
+        unsigned int frames = 0;
+        unsigned int missed = 0;
+        unsigned int intervals = 0;
+        Clock::duration frameTime = Clock::duration::zero();
+        Clock::duration work = Clock::duration::zero();
+        Clock::duration sleep = Clock::duration::zero();
+        Clock::duration spin = Clock::duration::zero();
+        std::vector<float> latencies;
+        std::vector<float> oversleeps;
+    };
+
+    FramePacerSettings m_Settings;
+    FramePacerStats m_Stats;
+    Window m_Window;
+    bool m_Started = false;
+    Clock::time_point m_Deadline;
+    Clock::time_point m_FrameStart;
+    Clock::time_point m_Input;
+    Clock::time_point m_WindowStart;
+
+    static float milliseconds(Clock::duration duration) { return std::chrono::duration<float, std::milli>(duration).count(); }
+
+    void closeWindow(Clock::time_point now)
+    {
+        Window& w = m_Window;
+        float frames = static_cast<float>(w.frames);
+        m_Stats.frames = w.frames;
+        m_Stats.missed = w.missed;
+        m_Stats.frameMs = w.intervals ? milliseconds(w.frameTime) / w.intervals : 0.0f;
+        m_Stats.workMs = milliseconds(w.work) / frames;
+        m_Stats.sleepMs = milliseconds(w.sleep) / frames;
+        m_Stats.spinMs = milliseconds(w.spin) / frames;
+        std::sort(w.oversleeps.begin(), w.oversleeps.end());
+        m_Stats.oversleepMs = w.oversleeps.empty() ? 0.0f : w.oversleeps.back();
+        m_Stats.spinMarginMs = w.oversleeps.empty() ? 0.0f : w.oversleeps[w.oversleeps.size() * 9 / 10];
+        std::sort(w.latencies.begin(), w.latencies.end());
+        float sum = 0.0f;
+        for (float latency : w.latencies)
+            sum += latency;
+        m_Stats.latencyMs = sum / w.latencies.size();
+        m_Stats.latencyP99Ms = w.latencies[w.latencies.size() * 99 / 100];
+        m_Stats.latencyMaxMs = w.latencies.back();
+
+        m_Window = Window();
+        m_Window.latencies.reserve(m_Stats.frames + m_Stats.frames / 4);
+        m_Window.oversleeps.reserve(m_Stats.frames + m_Stats.frames / 4);
+        m_WindowStart = now;
+    }
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small pool of worker threads that runs fire-and-forget jobs and data-parallel loops. Used for
+// work that must stay off the render thread (chunk streaming, decoding) or can be split across
+// cores (culling), never for anything touching GL.
+class JobSystem
+{
+public:
+    // threadCount of 0 picks one worker per hardware thread, leaving one for the render loop
+    JobSystem(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+        {
+            unsigned int hardwareThreads = std::thread::hardware_concurrency();
+            threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+        }
+        for (unsigned int i = 0; i < threadCount; i++)
+            m_Workers.emplace_back([this]() { WorkerLoop(); });
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_JobAvailable.notify_all();
+        for (std::thread& worker : m_Workers)
+            worker.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // queues a job; it runs on whichever worker picks it up first
+    void Submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Jobs.push_back(std::move(job));
+        }
+        m_JobAvailable.notify_one();
+    }
+
+    // blocks until every queued job has finished
+    void WaitIdle()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Idle.wait(lock, [this]() { return m_Jobs.empty() && m_Running == 0; });
+    }
+
+    // runs task(0) .. task(count - 1) across the workers and the calling thread, returns when all are done.
+    // The caller helps out, so this finishes even while the workers are busy with streaming jobs.
+    void ParallelFor(unsigned int count, const std::function<void(unsigned int)>& task)
+    {
+        if (count == 0)
+            return;
+
+        // shared so that helper jobs which only get scheduled after we return still see valid state
+        struct Loop {
+            std::function<void(unsigned int)> task;
+            unsigned int count;
+            std::atomic<unsigned int> next{ 0 };
+            std::atomic<unsigned int> finished{ 0 };
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+        loop->task = task;
+        loop->count = count;
+
+        auto run = [loop]() {
+            unsigned int i;
+            while ((i = loop->next++) < loop->count)
+            {
+                loop->task(i);
+                if (++loop->finished == loop->count)
+                {
+                    std::lock_guard<std::mutex> lock(loop->mutex);
+                    loop->done.notify_all();
+                }
+            }
+        };
+
+        unsigned int helpers = std::min(count - 1, ThreadCount());
+        for (unsigned int i = 0; i < helpers; i++)
+            Submit(run);
+        run();
+
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        loop->done.wait(lock, [&loop]() { return loop->finished == loop->count; });
+    }
+
+    unsigned int ThreadCount() const { return static_cast<unsigned int>(m_Workers.size()); }
+
+private:
+    std::vector<std::thread> m_Workers;
+    std::deque<std::function<void()>> m_Jobs;
+    std::mutex m_Mutex;
+    std::condition_variable m_JobAvailable;
+    std::condition_variable m_Idle;
+    unsigned int m_Running = 0;
+    bool m_Stopping = false;
+
+    void WorkerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_JobAvailable.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+                if (m_Jobs.empty())
+                    return;
+                job = std::move(m_Jobs.front());
+                m_Jobs.pop_front();
+                m_Running++;
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Running--;
+                if (m_Jobs.empty() && m_Running == 0)
+                    m_Idle.notify_all();
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,334 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+enum LightType : uint32_t {
+    LIGHT_POINT = 0,
+    LIGHT_SPOT = 1
+};
+
+// a dynamic light in world space; spot cones are given as cosines of the half angles
+struct Light {
+    uint32_t type = LIGHT_POINT;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 color = glm::vec3(1.0f);
+    float intensity = 1.0f;
+    float range = 5.0f;         // the light has no effect past this distance
+    float cosInner = 0.9f;      // full intensity inside this cone
+    float cosOuter = 0.8f;      // no light outside this cone
+};
+
+struct ClusterSettings {
+    int tilesX = 16;
+    int tilesY = 9;
+    int slices = 24;            // exponentially spaced between the near and far planes
+    float nearPlane = 0.1f;
+    float farPlane = 100.0f;
+    // caps the per-fragment loop; lights past the cap are dropped from that cluster and counted
+    unsigned int maxLightsPerCluster = 128;
+};
+
+struct ClusterStats {
+    unsigned int lights = 0;
+    unsigned int visibleLights = 0;
+    unsigned int indices = 0;
+    unsigned int maxLightsInCluster = 0;
+    unsigned int overflowedClusters = 0;
+    float buildMs = 0.0f;
+};
+
+// Bins lights into a froxel grid (screen tiles x exponential depth slices) in view space. The
+// output is three flat arrays shaped for texture buffers:
+//   LightData()      3 texels per visible light: view position + range, color + cos outer, view direction + cos inner
+//   ClusterRanges()  2 uints per cluster: offset into LightIndices(), light count
+//   LightIndices()   indices into LightData(), grouped by cluster
+// Clusters are numbered (slice * tilesY + tileY) * tilesX + tileX. Everything is GL-free;
+// ClusteredLighting uploads the arrays.
+class LightClusterBuilder
+{
+public:
+    LightClusterBuilder(const ClusterSettings& settings = ClusterSettings())
+        : m_Settings(settings), m_Slices(settings.slices)
+    {
+    }
+
+    const ClusterSettings& Settings() const { return m_Settings; }
+    unsigned int ClusterCount() const { return static_cast<unsigned int>(m_Settings.tilesX * m_Settings.tilesY * m_Settings.slices); }
+    const std::vector<glm::vec4>& LightData() const { return m_LightData; }
+    const std::vector<uint32_t>& ClusterRanges() const { return m_Ranges; }
+    const std::vector<uint32_t>& LightIndices() const { return m_Indices; }
+    const ClusterStats& Stats() const { return m_Stats; }
+
+    // slice = log(depth) * DepthScale() + DepthBias(), the same mapping the fragment shaders use
+    float DepthScale() const { return m_Settings.slices / std::log(m_Settings.farPlane / m_Settings.nearPlane); }
+    float DepthBias() const { return -std::log(m_Settings.nearPlane) * DepthScale(); }
+
+    // projection must be a symmetric perspective matrix using the settings' near and far planes
+    void Build(const std::vector<Light>& lights, const glm::mat4& view, const glm::mat4& projection, JobSystem& jobs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        m_Stats = ClusterStats();
+        m_Stats.lights = static_cast<unsigned int>(lights.size());
+        if (projection[0][0] != m_ProjectionX || projection[1][1] != m_ProjectionY)
+            buildClusterBounds(projection[0][0], projection[1][1]);
+
+        // 1. view-space bounding sphere and the block of clusters it overlaps, per light
+        const unsigned int batchSize = 1024;
+        m_Bounds.resize(lights.size());
+        unsigned int lightBatches = static_cast<unsigned int>((lights.size() + batchSize - 1) / batchSize);
+        jobs.ParallelFor(lightBatches, [&](unsigned int batch) {
+            size_t end = std::min<size_t>(lights.size(), (batch + 1) * batchSize);
+            for (size_t i = batch * batchSize; i < end; i++)
+                m_Bounds[i] = lightBounds(lights[i], view);
+        });
+
+        m_Visible.clear();
+        for (unsigned int i = 0; i < lights.size(); i++)
+            if (m_Bounds[i].visible)
+                m_Visible.push_back(i);
+        m_Stats.visibleLights = static_cast<unsigned int>(m_Visible.size());
+
+        // 2. shader-side light records for the visible lights, in view space
+        m_LightData.resize(m_Visible.size() * 3);
+        glm::mat3 viewRotation(view);
+        unsigned int visibleBatches = static_cast<unsigned int>((m_Visible.size() + batchSize - 1) / batchSize);
+        jobs.ParallelFor(visibleBatches, [&](unsigned int batch) {
+            size_t end = std::min<size_t>(m_Visible.size(), (batch + 1) * batchSize);
+            for (size_t i = batch * batchSize; i < end; i++)
+            {
+                const Light& light = lights[m_Visible[i]];
+                bool spot = light.type == LIGHT_SPOT;
+                m_LightData[i * 3 + 0] = glm::vec4(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.range);
+                // a point light gets a cone wider than the sphere, so the shader needs no branch
+                m_LightData[i * 3 + 1] = glm::vec4(light.color * light.intensity, spot ? light.cosOuter : -2.0f);
+                m_LightData[i * 3 + 2] = glm::vec4(glm::normalize(viewRotation * light.direction), spot ? light.cosInner : -1.0f);
+            }
+        });
+
+        // 3. one job per depth slice: exact sphere / cluster tests, then a counting sort into clusters
+        jobs.ParallelFor(static_cast<unsigned int>(m_Settings.slices), [this](unsigned int slice) { binSlice(slice); });
+
+        // 4. stitch the slices together
+        unsigned int clustersPerSlice = static_cast<unsigned int>(m_Settings.tilesX * m_Settings.tilesY);
+        m_Ranges.resize(ClusterCount() * 2);
+        uint32_t offset = 0;
+        for (int s = 0; s < m_Settings.slices; s++)
+        {
+            Slice& slice = m_Slices[s];
+            slice.offset = offset;
+            offset += static_cast<uint32_t>(slice.indices.size());
+            for (unsigned int c = 0; c < clustersPerSlice; c++)
+            {
+                unsigned int cluster = s * clustersPerSlice + c;
+                m_Ranges[cluster * 2 + 0] = slice.offset + slice.starts[c];
+                m_Ranges[cluster * 2 + 1] = slice.counts[c];
+                m_Stats.maxLightsInCluster = std::max(m_Stats.maxLightsInCluster, slice.counts[c]);
+            }
+            m_Stats.overflowedClusters += slice.overflowed;
+        }
+        m_Indices.resize(offset);
+        jobs.ParallelFor(static_cast<unsigned int>(m_Settings.slices), [this](unsigned int s) {
+            std::copy(m_Slices[s].indices.begin(), m_Slices[s].indices.end(), m_Indices.begin() + m_Slices[s].offset);
+        });
+        m_Stats.indices = offset;
+
+        m_Stats.buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    struct ClusterBox {
+        glm::vec3 min;
+        glm::vec3 max;
+    };
+
+    struct LightBounds {
+        glm::vec3 center;   // view space
+        float radius;
+        int x0, x1, y0, y1, z0, z1;
+        bool visible;
+    };
+
+    // per-slice scratch, kept between frames so building does not allocate once warmed up
+    struct Slice {
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;   // (cluster in slice, visible light), before sorting
+        std::vector<uint32_t> counts;
+        std::vector<uint32_t> starts;
+        std::vector<uint32_t> cursors;
+        std::vector<uint32_t> indices;
+        uint32_t offset = 0;
+        unsigned int overflowed = 0;
+    };
+
+    ClusterSettings m_Settings;
+    float m_ProjectionX = 0.0f, m_ProjectionY = 0.0f;
+    std::vector<ClusterBox> m_ClusterBoxes;
+    std::vector<LightBounds> m_Bounds;
+    std::vector<unsigned int> m_Visible;
+    std::vector<Slice> m_Slices;
+    std::vector<glm::vec4> m_LightData;
+    std::vector<uint32_t> m_Ranges;
+    std::vector<uint32_t> m_Indices;
+    ClusterStats m_Stats;
+
+    float sliceDepth(int slice) const
+    {
+        return m_Settings.nearPlane * std::pow(m_Settings.farPlane / m_Settings.nearPlane, static_cast<float>(slice) / m_Settings.slices);
+    }
+
+    // view-space AABB of every cluster; only changes with the projection
+    void buildClusterBounds(float projectionX, float projectionY)
+    {
+        m_ProjectionX = projectionX;
+        m_ProjectionY = projectionY;
+        m_ClusterBoxes.resize(ClusterCount());
+        for (int s = 0; s < m_Settings.slices; s++)
+        {
+            float nearDepth = sliceDepth(s), farDepth = sliceDepth(s + 1);
+            for (int y = 0; y < m_Settings.tilesY; y++)
+                for (int x = 0; x < m_Settings.tilesX; x++)
+                {
+                    float ndcX0 = -1.0f + 2.0f * x / m_Settings.tilesX, ndcX1 = -1.0f + 2.0f * (x + 1) / m_Settings.tilesX;
+                    float ndcY0 = -1.0f + 2.0f * y / m_Settings.tilesY, ndcY1 = -1.0f + 2.0f * (y + 1) / m_Settings.tilesY;
+                    ClusterBox box{ glm::vec3(1e30f), glm::vec3(-1e30f) };
+                    for (float depth : { nearDepth, farDepth })
+                        for (float ndcX : { ndcX0, ndcX1 })
+                            for (float ndcY : { ndcY0, ndcY1 })
+                            {
+                                glm::vec3 corner(ndcX * depth / projectionX, ndcY * depth / projectionY, -depth);
+                                box.min = glm::min(box.min, corner);
+                                box.max = glm::max(box.max, corner);
+                            }
+                    m_ClusterBoxes[(s * m_Settings.tilesY + y) * m_Settings.tilesX + x] = box;
+                }
+        }
+    }
+
+    int depthSlice(float depth) const
+    {
+        int slice = static_cast<int>(std::floor(std::log(depth) * DepthScale() + DepthBias()));
+        return std::max(0, std::min(m_Settings.slices - 1, slice));
+    }
+
+    int tile(float ndc, int tiles) const
+    {
+        int t = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * tiles));
+        return std::max(0, std::min(tiles - 1, t));
+    }
+
+    LightBounds lightBounds(const Light& light, const glm::mat4& view) const
+    {
+        LightBounds bounds;
+        glm::vec3 center = light.position;
+        float radius = light.range;
+        if (light.type == LIGHT_SPOT)
+        {
+            // smallest sphere around the cone instead of the whole range sphere
+            float cosAngle = std::max(light.cosOuter, 0.0f);
+            glm::vec3 direction = glm::normalize(light.direction);
+            if (cosAngle > 0.70710678f)
+            {
+                radius = light.range / (2.0f * cosAngle);
+                center = light.position + direction * radius;
+            }
+            else
+            {
+                radius = light.range * std::sqrt(1.0f - cosAngle * cosAngle);
+                center = light.position + direction * (light.range * cosAngle);
+            }
+        }
+        bounds.center = glm::vec3(view * glm::vec4(center, 1.0f));
+        bounds.radius = radius;
+
+        float nearDepth = std::max(-bounds.center.z - radius, m_Settings.nearPlane);
+        float farDepth = -bounds.center.z + radius;
+        bounds.visible = farDepth > m_Settings.nearPlane && nearDepth < m_Settings.farPlane;
+        if (!bounds.visible)
+            return bounds;
+        farDepth = std::min(farDepth, m_Settings.farPlane);
+
+        // project the view-space box of the sphere; the widest extent is at the nearer depth on the outer side
+        float minX = bounds.center.x - radius, maxX = bounds.center.x + radius;
+        float minY = bounds.center.y - radius, maxY = bounds.center.y + radius;
+        float ndcMinX = m_ProjectionX * minX / (minX < 0.0f ? nearDepth : farDepth);
+        float ndcMaxX = m_ProjectionX * maxX / (maxX > 0.0f ? nearDepth : farDepth);
+        float ndcMinY = m_ProjectionY * minY / (minY < 0.0f ? nearDepth : farDepth);
+        float ndcMaxY = m_ProjectionY * maxY / (maxY > 0.0f ? nearDepth : farDepth);
+        if (ndcMinX > 1.0f || ndcMaxX < -1.0f || ndcMinY > 1.0f || ndcMaxY < -1.0f)
+        {
+            bounds.visible = false;
+            return bounds;
+        }
+
+        bounds.x0 = tile(ndcMinX, m_Settings.tilesX);
+        bounds.x1 = tile(ndcMaxX, m_Settings.tilesX);
+        bounds.y0 = tile(ndcMinY, m_Settings.tilesY);
+        bounds.y1 = tile(ndcMaxY, m_Settings.tilesY);
+        bounds.z0 = depthSlice(nearDepth);
+        bounds.z1 = depthSlice(farDepth);
+        return bounds;
+    }
+
+    void binSlice(unsigned int s)
+    {
+        Slice& slice = m_Slices[s];
+        unsigned int clustersPerSlice = static_cast<unsigned int>(m_Settings.tilesX * m_Settings.tilesY);
+        slice.pairs.clear();
+        slice.counts.assign(clustersPerSlice, 0);
+        slice.starts.resize(clustersPerSlice);
+        slice.overflowed = 0;
+
+        const ClusterBox* boxes = &m_ClusterBoxes[s * clustersPerSlice];
+        for (uint32_t v = 0; v < m_Visible.size(); v++)
+        {
+            const LightBounds& bounds = m_Bounds[m_Visible[v]];
+            if (static_cast<int>(s) < bounds.z0 || static_cast<int>(s) > bounds.z1)
+                continue;
+            float radiusSquared = bounds.radius * bounds.radius;
+            for (int y = bounds.y0; y <= bounds.y1; y++)
+                for (int x = bounds.x0; x <= bounds.x1; x++)
+                {
+                    unsigned int cluster = y * m_Settings.tilesX + x;
+                    glm::vec3 closest = glm::clamp(bounds.center, boxes[cluster].min, boxes[cluster].max);
+                    glm::vec3 offset = closest - bounds.center;
+                    if (glm::dot(offset, offset) > radiusSquared)
+                        continue;
+                    if (slice.counts[cluster] == m_Settings.maxLightsPerCluster)
+                    {
+                        slice.overflowed++;
+                        slice.counts[cluster]++;    // marks the cluster so it is only counted once
+                        continue;
+                    }
+                    if (slice.counts[cluster] > m_Settings.maxLightsPerCluster)
+                        continue;
+                    slice.counts[cluster]++;
+                    slice.pairs.emplace_back(cluster, v);
+                }
+        }
+
+        uint32_t running = 0;
+        for (unsigned int c = 0; c < clustersPerSlice; c++)
+        {
+            slice.counts[c] = std::min(slice.counts[c], m_Settings.maxLightsPerCluster);
+            slice.starts[c] = running;
+            running += slice.counts[c];
+        }
+        // pairs were produced in light order, so the stable fill keeps each cluster's list sorted
+        slice.indices.resize(running);
+        slice.cursors = slice.starts;
+        for (const std::pair<uint32_t, uint32_t>& pair : slice.pairs)
+            slice.indices[slice.cursors[pair.first]++] = pair.second;
+    }
+};
+
+#endif
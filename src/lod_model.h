@@ -0,0 +1,225 @@
+#ifndef LOD_MODEL_H
+#define LOD_MODEL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader_m.h>
+
+#include "lod_settings.h"
+#include "mesh_simplify.h"
+#include "packed_mesh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// learnopengl's Mesh never frees its GL objects and keeps its buffers private; they are read back
+// from its VAO. For a mesh whose geometry now lives in a LodModel; its textures are left alone.
+inline void releaseMeshBuffers(Mesh& mesh)
+{
+    GLint vertexBuffer = 0, elementBuffer = 0;
+    glBindVertexArray(mesh.VAO);
+    glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vertexBuffer);
+    glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &elementBuffer);
+    glBindVertexArray(0);
+    GLuint buffers[2] = { static_cast<GLuint>(vertexBuffer), static_cast<GLuint>(elementBuffer) };
+    glDeleteBuffers(2, buffers);
+    glDeleteVertexArrays(1, &mesh.VAO);
+    mesh.VAO = 0;
+}
+
+// triangles drawn vs triangles that full-resolution rendering would have drawn
+struct LodStats {
+    unsigned long long fullTriangles = 0;
+    unsigned long long submittedTriangles = 0;
+};
+
+// A model's meshes simplified into a chain of levels at load time. Every level, including the
+// full-detail one, is uploaded in the packed vertex format; coarser levels only hold the
+// vertices they still reference.
+class LodModel
+{
+public:
+    glm::vec3 Center;   // local-space bounding sphere
+    float Radius;
+    // CPU copy of the coarsest level, all meshes merged; used as occluder geometry
+    std::vector<glm::vec3> OccluderPositions;
+    std::vector<unsigned int> OccluderIndices;
+
+    LodModel(std::vector<Mesh>& meshes, const std::string& name, const LodSettings& settings = LodSettings())
+        : m_Settings(settings)
+    {
+        glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+        for (const Mesh& mesh : meshes)
+            for (const Vertex& vertex : mesh.vertices)
+            {
+                minP = glm::min(minP, vertex.Position);
+                maxP = glm::max(maxP, vertex.Position);
+            }
+        Center = (minP + maxP) * 0.5f;
+        Radius = glm::length(maxP - minP) * 0.5f;
+
+        PackingStats packing;
+        m_Levels.resize(1);
+        std::vector<std::vector<glm::vec3>> positions(meshes.size());
+        std::vector<std::vector<unsigned int>> indices(meshes.size());
+        for (unsigned int m = 0; m < meshes.size(); m++)
+        {
+            Mesh& mesh = meshes[m];
+            for (const Vertex& vertex : mesh.vertices)
+                positions[m].push_back(vertex.Position);
+            indices[m] = mesh.indices;
+            m_OwnedMeshes.emplace_back(new PackedMesh(mesh.vertices, mesh.indices, mesh.textures, false, &packing));
+            m_Levels[0].meshes.push_back(m_OwnedMeshes.back().get());
+            m_Levels[0].triangles += static_cast<unsigned int>(mesh.indices.size() / 3);
+        }
+
+        for (unsigned int level = 0; level < settings.triangleRatios.size(); level++)
+            if (!buildLevel(meshes, settings.triangleRatios[level], settings.targetErrors[level], packing, positions, indices))
+                break;
+        setOccluder(positions, indices);
+
+        reportPacking(name, packing);
+
+        std::cout << "LOD " << name << ":";
+        for (const Level& level : m_Levels)
+            std::cout << " " << level.triangles;
+        std::cout << " triangles" << std::endl;
+        if (m_Levels.size() == 1)
+            std::cout << "WARNING::LOD::NO_REDUCTION " << name << " could not be simplified within the error budget" << std::endl;
+    }
+
+    unsigned int LevelCount() const { return static_cast<unsigned int>(m_Levels.size()); }
+    unsigned int TriangleCount(unsigned int level) const { return m_Levels[level].triangles; }
+
+    // vertex and index buffers of every level
+    size_t GpuBytes() const
+    {
+        size_t bytes = 0;
+        for (const auto& mesh : m_OwnedMeshes)
+            bytes += mesh->GpuBytes;
+        return bytes;
+    }
+
+    size_t CpuBytes() const { return OccluderPositions.capacity() * sizeof(glm::vec3) + OccluderIndices.capacity() * sizeof(unsigned int); }
+
+    // picks a level from the projected size of the bounding sphere. currentLevel is the level the
+    // instance used last frame; a level boundary has to be crossed by the hysteresis margin before
+    // the instance switches, so objects sitting on a threshold don't pop back and forth
+    unsigned int SelectLevel(const glm::mat4& model, const glm::vec3& cameraPosition, float fovY, unsigned int currentLevel) const
+    {
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(Center, 1.0f));
+        float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        float distance = std::max(glm::length(worldCenter - cameraPosition), 1e-4f);
+        float screenSize = Radius * scale / (distance * std::tan(fovY * 0.5f));
+
+        unsigned int level = 0;
+        for (unsigned int i = 0; i + 1 < m_Levels.size() && i < m_Settings.screenSizes.size(); i++)
+        {
+            float threshold = m_Settings.screenSizes[i];
+            threshold *= currentLevel <= i ? 1.0f - m_Settings.hysteresis : 1.0f + m_Settings.hysteresis;
+            if (screenSize < threshold)
+                level = i + 1;
+        }
+        return level;
+    }
+
+    void Draw(Shader& shader, unsigned int level, LodStats* stats = nullptr)
+    {
+        for (PackedMesh* mesh : m_Levels[level].meshes)
+            mesh->Draw(shader);
+        if (stats)
+        {
+            stats->fullTriangles += m_Levels[0].triangles;
+            stats->submittedTriangles += m_Levels[level].triangles;
+        }
+    }
+
+private:
+    struct Level {
+        std::vector<PackedMesh*> meshes;
+        unsigned int triangles = 0;
+    };
+
+    LodSettings m_Settings;
+    std::vector<Level> m_Levels;
+    std::vector<std::unique_ptr<PackedMesh>> m_OwnedMeshes;
+
+    // on success, coarsePositions / coarseIndices are replaced by the new level's geometry
+    bool buildLevel(std::vector<Mesh>& sourceMeshes, float ratio, float targetError, PackingStats& packing,
+                    std::vector<std::vector<glm::vec3>>& coarsePositions, std::vector<std::vector<unsigned int>>& coarseIndices)
+    {
+        std::vector<std::vector<Vertex>> levelVertices(sourceMeshes.size());
+        std::vector<std::vector<unsigned int>> levelIndices(sourceMeshes.size());
+        unsigned int triangles = 0;
+        for (unsigned int m = 0; m < sourceMeshes.size(); m++)
+        {
+            const Mesh& source = sourceMeshes[m];
+            std::vector<glm::vec3> positions(source.vertices.size());
+            std::vector<glm::vec3> normals(source.vertices.size());
+            std::vector<glm::vec2> uvs(source.vertices.size());
+            for (unsigned int i = 0; i < source.vertices.size(); i++)
+            {
+                positions[i] = source.vertices[i].Position;
+                normals[i] = source.vertices[i].Normal;
+                uvs[i] = source.vertices[i].TexCoords;
+            }
+
+            size_t target = static_cast<size_t>(source.indices.size() / 3 * ratio) * 3;
+            SimplifyResult simplified = simplifyMesh(positions, normals, uvs, source.indices, target, targetError);
+
+            // compact to the vertices that survived
+            std::vector<unsigned int> remap(source.vertices.size(), ~0u);
+            levelIndices[m].reserve(simplified.indices.size());
+            for (unsigned int index : simplified.indices)
+            {
+                if (remap[index] == ~0u)
+                {
+                    remap[index] = static_cast<unsigned int>(levelVertices[m].size());
+                    levelVertices[m].push_back(source.vertices[index]);
+                }
+                levelIndices[m].push_back(remap[index]);
+            }
+            triangles += static_cast<unsigned int>(levelIndices[m].size() / 3);
+        }
+
+        // stop once the error budget no longer lets the mesh get meaningfully smaller
+        if (triangles == 0 || triangles > m_Levels.back().triangles * (1.0f - m_Settings.minReduction))
+            return false;
+
+        Level level;
+        level.triangles = triangles;
+        for (unsigned int m = 0; m < sourceMeshes.size(); m++)
+        {
+            m_OwnedMeshes.emplace_back(new PackedMesh(levelVertices[m], levelIndices[m], sourceMeshes[m].textures, false, &packing));
+            level.meshes.push_back(m_OwnedMeshes.back().get());
+
+            coarsePositions[m].resize(levelVertices[m].size());
+            for (unsigned int i = 0; i < levelVertices[m].size(); i++)
+                coarsePositions[m][i] = levelVertices[m][i].Position;
+            coarseIndices[m] = levelIndices[m];
+        }
+        m_Levels.push_back(level);
+        return true;
+    }
+
+    void setOccluder(const std::vector<std::vector<glm::vec3>>& positions, const std::vector<std::vector<unsigned int>>& indices)
+    {
+        for (unsigned int m = 0; m < positions.size(); m++)
+        {
+            unsigned int base = static_cast<unsigned int>(OccluderPositions.size());
+            OccluderPositions.insert(OccluderPositions.end(), positions[m].begin(), positions[m].end());
+            for (unsigned int index : indices[m])
+                OccluderIndices.push_back(base + index);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef LOD_SETTINGS_H
+#define LOD_SETTINGS_H
+
+#include <vector>
+
+// How LodModel builds and picks its levels. GL-free, so engine_benchmark simplifies with the
+// same defaults the demo ships.
+struct LodSettings {
+    // per generated level: fraction of the source triangles to aim for and the error it may not exceed
+    std::vector<float> triangleRatios = { 0.5f, 0.25f, 0.1f };
+    std::vector<float> targetErrors = { 0.005f, 0.015f, 0.04f };
+    // projected height (fraction of the viewport) below which level i + 1 replaces level i
+    std::vector<float> screenSizes = { 0.4f, 0.2f, 0.08f };
+    float hysteresis = 0.15f;
+    // a level that does not remove at least this fraction of the previous one is dropped
+    float minReduction = 0.1f;
+};
+
+#endif
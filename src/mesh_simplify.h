@@ -0,0 +1,305 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <vector>
+
+// Edge-collapse simplification driven by quadric error metrics (Garland & Heckbert).
+//
+// Vertices are only ever collapsed onto an existing neighbour, so the output reuses the
+// input vertex buffer untouched - texture coordinates, normals and bone weights stay valid
+// without any interpolation. Importers don't weld (assimp gives every face corner its own
+// vertex), so vertices are first welded by position and collapses move whole positions. Among
+// the vertices at one position, those with the same normal and UV are interchangeable; a
+// position where they differ is an attribute seam and is locked, as are open borders, so
+// silhouettes and UV charts survive.
+
+struct SimplifyResult {
+    std::vector<unsigned int> indices;
+    float error;    // largest collapse error, relative to the mesh extent
+};
+
+namespace simplify_detail {
+    // symmetric 4x4 plane quadric, stored as its 10 unique terms plus the accumulated area
+    struct Quadric {
+        float a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+        float b0 = 0, b1 = 0, b2 = 0, c = 0;
+        float weight = 0;
+
+        void AddPlane(const glm::vec3& n, float d, float w)
+        {
+            a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z;
+            a11 += w * n.y * n.y; a12 += w * n.y * n.z; a22 += w * n.z * n.z;
+            b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void Add(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+            weight += q.weight;
+        }
+
+        // area-weighted mean squared distance from p to the accumulated planes
+        float Error(const glm::vec3& p) const
+        {
+            float rx = a00 * p.x + a01 * p.y + a02 * p.z;
+            float ry = a01 * p.x + a11 * p.y + a12 * p.z;
+            float rz = a02 * p.x + a12 * p.y + a22 * p.z;
+            float e = p.x * rx + p.y * ry + p.z * rz + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+            return std::fabs(e) / std::max(weight, 1e-12f);
+        }
+    };
+
+    struct Collapse {
+        float cost;
+        unsigned int from;
+        unsigned int to;
+        unsigned int version;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+}
+
+// Simplifies an indexed triangle list until it reaches targetIndexCount or no collapse stays
+// under targetError (a fraction of the mesh extent, e.g. 0.01 = 1%). normals and uvs are per
+// vertex and may be left empty. Output indices refer to the input vertices.
+inline SimplifyResult simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals,
+                                   const std::vector<glm::vec2>& uvs, const std::vector<unsigned int>& indices,
+                                   size_t targetIndexCount, float targetError)
+{
+    using namespace simplify_detail;
+
+    const unsigned int vertexCount = static_cast<unsigned int>(positions.size());
+    const size_t triangleCount = indices.size() / 3;
+
+    glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+    for (const glm::vec3& p : positions)
+    {
+        minP = glm::min(minP, p);
+        maxP = glm::max(maxP, p);
+    }
+    glm::vec3 size = maxP - minP;
+    float extent = std::max(std::max(size.x, size.y), std::max(size.z, 1e-6f));
+    float maxErrorSq = (targetError * extent) * (targetError * extent);
+
+    // weld by position into points; each point keeps one wedge (representative vertex) per
+    // distinct normal/UV pair, and every vertex maps to its wedge
+    auto sameAttributes = [&](unsigned int a, unsigned int b) {
+        if (!normals.empty() && glm::dot(normals[a], normals[b]) < 0.999f)
+            return false;
+        if (!uvs.empty() && (std::fabs(uvs[a].x - uvs[b].x) > 1e-5f || std::fabs(uvs[a].y - uvs[b].y) > 1e-5f))
+            return false;
+        return true;
+    };
+    std::map<std::tuple<float, float, float>, unsigned int> positionLookup;
+    std::vector<unsigned int> pointOf(vertexCount);
+    std::vector<unsigned int> wedgeOf(vertexCount);
+    std::vector<std::vector<unsigned int>> pointWedges;
+    for (unsigned int v = 0; v < vertexCount; v++)
+    {
+        auto key = std::make_tuple(positions[v].x, positions[v].y, positions[v].z);
+        auto it = positionLookup.find(key);
+        unsigned int point;
+        if (it == positionLookup.end())
+        {
+            point = positionLookup[key] = static_cast<unsigned int>(pointWedges.size());
+            pointWedges.emplace_back();
+        }
+        else
+            point = it->second;
+        pointOf[v] = point;
+        wedgeOf[v] = v;
+        for (unsigned int wedge : pointWedges[point])
+            if (sameAttributes(v, wedge))
+            {
+                wedgeOf[v] = wedge;
+                break;
+            }
+        if (wedgeOf[v] == v)
+            pointWedges[point].push_back(v);
+    }
+    const unsigned int pointCount = static_cast<unsigned int>(pointWedges.size());
+
+    std::vector<bool> locked(pointCount, false);
+    for (unsigned int p = 0; p < pointCount; p++)
+        locked[p] = pointWedges[p].size() > 1;
+
+    // open borders: point edges used by a single triangle
+    std::map<std::pair<unsigned int, unsigned int>, int> edgeUse;
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int e = 0; e < 3; e++)
+        {
+            unsigned int a = pointOf[indices[t * 3 + e]], b = pointOf[indices[t * 3 + (e + 1) % 3]];
+            edgeUse[std::make_pair(std::min(a, b), std::max(a, b))]++;
+        }
+    for (const auto& edge : edgeUse)
+        if (edge.second == 1)
+            locked[edge.first.first] = locked[edge.first.second] = true;
+
+    // corners hold wedges; pointPositions is where each point sits
+    std::vector<glm::vec3> pointPositions(pointCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        pointPositions[pointOf[v]] = positions[v];
+    std::vector<unsigned int> corners(indices.size());
+    std::vector<unsigned int> cornerPoints(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        corners[i] = wedgeOf[indices[i]];
+        cornerPoints[i] = pointOf[indices[i]];
+    }
+
+    std::vector<Quadric> quadrics(pointCount);
+    std::vector<std::vector<unsigned int>> pointTriangles(pointCount);
+    std::vector<bool> triangleAlive(triangleCount, true);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& p0 = pointPositions[cornerPoints[t * 3 + 0]];
+        const glm::vec3& p1 = pointPositions[cornerPoints[t * 3 + 1]];
+        const glm::vec3& p2 = pointPositions[cornerPoints[t * 3 + 2]];
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area > 0.0f)
+        {
+            n = n / area;
+            float d = -glm::dot(n, p0);
+            for (int c = 0; c < 3; c++)
+                quadrics[cornerPoints[t * 3 + c]].AddPlane(n, d, area * 0.5f);
+        }
+        for (int c = 0; c < 3; c++)
+            pointTriangles[cornerPoints[t * 3 + c]].push_back(static_cast<unsigned int>(t));
+    }
+
+    std::vector<unsigned int> version(pointCount, 0);
+    std::vector<bool> removed(pointCount, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+    auto pushCollapses = [&](unsigned int p) {
+        for (unsigned int t : pointTriangles[p])
+        {
+            if (!triangleAlive[t])
+                continue;
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int n = cornerPoints[t * 3 + c];
+                if (n == p)
+                    continue;
+                if (!locked[p])
+                    queue.push(Collapse{ quadrics[p].Error(pointPositions[n]), p, n, version[p] });
+                if (!locked[n])
+                    queue.push(Collapse{ quadrics[n].Error(pointPositions[p]), n, p, version[n] });
+            }
+        }
+    };
+    for (unsigned int p = 0; p < pointCount; p++)
+        if (!locked[p])
+            pushCollapses(p);
+
+    // the wedge of the target point whose attributes are closest to those of the collapsing one
+    auto closestWedge = [&](unsigned int from, unsigned int to) {
+        unsigned int source = pointWedges[from][0];
+        unsigned int best = pointWedges[to][0];
+        float bestDistance = FLT_MAX;
+        for (unsigned int wedge : pointWedges[to])
+        {
+            float distance = 0.0f;
+            if (!normals.empty())
+                distance += 1.0f - glm::dot(normals[source], normals[wedge]);
+            if (!uvs.empty())
+                distance += glm::length(uvs[source] - uvs[wedge]);
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = wedge;
+            }
+        }
+        return best;
+    };
+
+    size_t liveTriangles = triangleCount;
+    float worstError = 0.0f;
+    while (!queue.empty() && liveTriangles * 3 > targetIndexCount)
+    {
+        Collapse collapse = queue.top();
+        queue.pop();
+        if (removed[collapse.from] || removed[collapse.to] || collapse.version != version[collapse.from])
+            continue;
+        if (collapse.cost > maxErrorSq)
+            break;
+
+        // reject collapses that would flip a surviving triangle
+        const glm::vec3& target = pointPositions[collapse.to];
+        bool flips = false;
+        for (unsigned int t : pointTriangles[collapse.from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            unsigned int i0 = cornerPoints[t * 3 + 0], i1 = cornerPoints[t * 3 + 1], i2 = cornerPoints[t * 3 + 2];
+            if (i0 == collapse.to || i1 == collapse.to || i2 == collapse.to)
+                continue;
+            glm::vec3 before = glm::cross(pointPositions[i1] - pointPositions[i0], pointPositions[i2] - pointPositions[i0]);
+            if (glm::dot(before, before) == 0.0f)
+                continue;
+            glm::vec3 p0 = i0 == collapse.from ? target : pointPositions[i0];
+            glm::vec3 p1 = i1 == collapse.from ? target : pointPositions[i1];
+            glm::vec3 p2 = i2 == collapse.from ? target : pointPositions[i2];
+            if (glm::dot(before, glm::cross(p1 - p0, p2 - p0)) <= 0.0f)
+            {
+                flips = true;
+                break;
+            }
+        }
+        if (flips)
+            continue;
+
+        // unlocked points have a single wedge, so every corner of the collapsing point moves to the same one
+        unsigned int targetWedge = closestWedge(collapse.from, collapse.to);
+        for (unsigned int t : pointTriangles[collapse.from])
+        {
+            if (!triangleAlive[t])
+                continue;
+            bool degenerate = false;
+            for (int c = 0; c < 3; c++)
+                if (cornerPoints[t * 3 + c] == collapse.to)
+                    degenerate = true;
+            if (degenerate)
+            {
+                triangleAlive[t] = false;
+                liveTriangles--;
+                continue;
+            }
+            for (int c = 0; c < 3; c++)
+                if (cornerPoints[t * 3 + c] == collapse.from)
+                {
+                    cornerPoints[t * 3 + c] = collapse.to;
+                    corners[t * 3 + c] = targetWedge;
+                }
+            pointTriangles[collapse.to].push_back(t);
+        }
+        pointTriangles[collapse.from].clear();
+        removed[collapse.from] = true;
+        quadrics[collapse.to].Add(quadrics[collapse.from]);
+        worstError = std::max(worstError, collapse.cost);
+
+        version[collapse.to]++;
+        pushCollapses(collapse.to);
+    }
+
+    SimplifyResult result;
+    result.error = std::sqrt(worstError) / extent;
+    result.indices.reserve(liveTriangles * 3);
+    for (size_t t = 0; t < triangleCount; t++)
+        if (triangleAlive[t])
+            result.indices.insert(result.indices.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+    return result;
+}
+
+#endif
@@ -10,12 +10,32 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include "clustered_lighting.h"
+#include "collision.h"
+#include "frame_pacer.h"
+#include "job_system.h"
+#include "lod_model.h"
+#include "navigation.h"
+#include "occlusion_culling.h"
+#include "packed_mesh.h"
+#include "player_simulation.h"
+#include "resource_tracking.h"
+#include "scene_format.h"
+#include "world_streamer.h"
+
+#include <filesystem>
 #include <iostream>
+#include <map>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void applyMouseMovement(double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow *window);
+unsigned int loadTexture(const char* path);
+bool cookDefaultScene(const std::string& path);
+std::vector<Light> makeDemoLights(unsigned int count, float extent);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -31,39 +51,61 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-glm::vec3 cubePosition(0.0f, 0.5f, 5.0f);
-float cubeSpeed = 2.5f;
+// frames are capped to the monitor's refresh rate by the pacer rather than by vsync, and events
+// are polled again right before the camera is built; F10 toggles the late poll
+FramePacerSettings framePacing;
+bool lateMouseSampling = true;
+
+// the player is simulated in fixed ticks by player_simulation.h, the same code the headless server
+// runs; cubePosition is where it is drawn, between the last two ticks
+PlayerSettings playerSettings;
+PlayerState player;
+glm::vec3 cubePosition = player.position;
 
 float cubeYaw = 0.0f;
 float mouseSensitivity = 0.1f;
 
 float cameraPitch = 10.0f;
 
-float cubeVelocityY = 0.0f;
-float gravity = -9.81f;
-bool isOnGround = true;
+// colliders of every resident chunk, refreshed each frame after the streamer update
+std::vector<ResidentEntity*> colliders;
 
-struct AABB {
-    glm::vec3 min;
-    glm::vec3 max;
-};
+// what textures, meshes and the world hold in memory; F9 writes a snapshot
+ResourceRegistry resources;
 
-bool checkCollisionAABB(const AABB& box1, const AABB& box2) {
-    return (box1.min.x <= box2.max.x && box1.max.x >= box2.min.x) &&
-        (box1.min.y <= box2.max.y && box1.max.y >= box2.min.y) &&
-        (box1.min.z <= box2.max.z && box1.max.z >= box2.min.z);
-}
+// the keyboard and the mouse-driven yaw as simulation input
+class GlfwPlayerInput : public PlayerInputSource
+{
+public:
+    GlfwPlayerInput(GLFWwindow* window)
+        : m_Window(window)
+    {
+    }
 
-AABB rockBox;
+    PlayerInput Poll() override
+    {
+        PlayerInput input;
+        input.forward = glfwGetKey(m_Window, GLFW_KEY_W) == GLFW_PRESS;
+        input.back = glfwGetKey(m_Window, GLFW_KEY_S) == GLFW_PRESS;
+        input.left = glfwGetKey(m_Window, GLFW_KEY_A) == GLFW_PRESS;
+        input.right = glfwGetKey(m_Window, GLFW_KEY_D) == GLFW_PRESS;
+        input.jump = glfwGetKey(m_Window, GLFW_KEY_SPACE) == GLFW_PRESS;
+        input.yaw = cubeYaw;
+        return input;
+    }
 
-struct Pillar {
-    glm::vec3 position;
-    glm::vec3 scale;
-    glm::vec3 color;
-    AABB box;
+private:
+    GLFWwindow* m_Window;
 };
 
-Pillar pillars[4];
+// a cube wandering between random points of the world on navmesh paths
+struct NavAgent {
+    glm::vec3 position;
+    std::vector<glm::vec3> waypoints;
+    unsigned int next = 0;          // waypoint being walked to
+    unsigned int request = 0;
+    bool waiting = false;           // for the path queue to answer request
+};
 
 int main()
 {
@@ -88,6 +130,10 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    if (videoMode && videoMode->refreshRate > 0)
+        framePacing.targetFps = static_cast<float>(videoMode->refreshRate);
+    glfwSwapInterval(framePacing.swapInterval);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -110,103 +156,126 @@ int main()
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
 
-    // build and compile shaders
-    // -------------------------
+    // build and compile shaders; the fragment shader includes the clustered light loop
+    // -------------------------------------------------------------------------------
+    std::string litFragmentShader = includeClusteredLighting("../../src/3.model_loading/1.model_loading/1.model_loading.fs");
     Shader ourShader(
         "../../src/3.model_loading/1.model_loading/1.model_loading.vs",
-        "../../src/3.model_loading/1.model_loading/1.model_loading.fs"
+        litFragmentShader.c_str()
     );
 
-    // load models
-    // -----------
-    Model ourModel(FileSystem::getPath("resources/objects/rock/rock.obj"));
-
-    glm::vec3 rockPos(0.0f, 0.0f, 0.0f);
-    glm::vec3 rockScale(1.0f);
-
-    glm::vec3 rockMin(FLT_MAX);
-    glm::vec3 rockMax(-FLT_MAX);
-
-    // loop ผ่านทุก mesh ใน model
-    for (unsigned int i = 0; i < ourModel.meshes.size(); i++)
+    // load scene
+    // ----------
+    // the scene is cooked from the built-in layout on first run (or when an older format is on disk);
+    // after that the file is the source of truth
+    std::string scenePath = FileSystem::getPath("resources/scenes/default.scene");
+    SceneFile scene;
+    if (!std::filesystem::exists(scenePath) || !scene.Load(scenePath))
     {
-        Mesh mesh = ourModel.meshes[i];
+        if (!cookDefaultScene(scenePath) || !scene.Load(scenePath))
+            return -1;
+    }
 
-        for (unsigned int v = 0; v < mesh.vertices.size(); v++)
+    // models are shared by every chunk that places them, so they are loaded (and their LODs built) once up front.
+    // the LOD levels hold their own copy of the geometry, so only the model's textures are kept
+    std::vector<std::unique_ptr<LodModel>> sceneLods(scene.Meshes.size());
+    for (unsigned int i = 0; i < scene.Meshes.size(); i++)
+        if (scene.Meshes[i].type == SCENE_MESH_MODEL)
         {
-            glm::vec3 pos = mesh.vertices[v].Position * rockScale + rockPos;
+            Model model(FileSystem::getPath(scene.Meshes[i].path));
+            sceneLods[i].reset(new LodModel(model.meshes, scene.Meshes[i].path));
+            for (const Texture& texture : model.textures_loaded)
+                trackTexture(resources, model.directory + "/" + texture.path, texture.id);
+            for (Mesh& mesh : model.meshes)
+                releaseMeshBuffers(mesh);
+            resources.Track(RESOURCE_MESH, scene.Meshes[i].path + " (LODs)", sceneLods[i]->CpuBytes(), sceneLods[i]->GpuBytes());
+        }
 
-            rockMin = glm::min(rockMin, pos);
-            rockMax = glm::max(rockMax, pos);
+    std::map<std::string, unsigned int> sceneTextures;
+    std::map<std::string, unsigned int> sceneTextureResources;
+    for (const SceneMaterial& material : scene.Materials)
+        if (!material.texturePath.empty() && !sceneTextures.count(material.texturePath))
+        {
+            std::string path = FileSystem::getPath(material.texturePath);
+            sceneTextures[material.texturePath] = loadTexture(path.c_str());
+            sceneTextureResources[material.texturePath] = resources.Find(resourceName(path));
         }
-    }
 
-    rockBox.min = rockMin;
-    rockBox.max = rockMax;
+    JobSystem jobs;
+    WorldStreamer streamer(scene, jobs);
+    streamer.LoadImmediately(cubePosition);
+    unsigned int streamedResource = resources.Track(RESOURCE_SCENE, "resident chunks", streamer.ResidentBytes() + streamer.PendingBytes(), 0);
+
+    // navigation: the whole world's walkable area, built once; agents ask the queue for paths and
+    // it answers as many as fit in a millisecond per frame
+    NavigationSettings navSettings;
+    NavigationGrid navGrid;
+    buildNavigationGrid(scene, navSettings, navGrid);
+    HierarchicalPathfinder pathfinder(navGrid, navSettings);
+    pathfinder.Build(jobs);
+    resources.Track(RESOURCE_NAVIGATION, "navigation grid and graph", navGrid.MemoryBytes() + pathfinder.MemoryBytes(), 0);
+    PathRequestQueue pathQueue(pathfinder);
+    const unsigned int NAV_AGENT_COUNT = 256;
+    const float NAV_AGENT_SPEED = 2.0f;
+    unsigned int navSeed = 777u;
+    auto navRandom01 = [&navSeed]() {
+        navSeed = navSeed * 1664525u + 1013904223u;
+        return static_cast<float>(navSeed >> 8) / static_cast<float>(1 << 24);
+    };
+    auto randomNavPoint = [&]() {
+        return navGrid.CellCenter(static_cast<int>(navRandom01() * navGrid.Width), static_cast<int>(navRandom01() * navGrid.Height));
+    };
+    std::vector<NavAgent> navAgents(NAV_AGENT_COUNT);
+    for (NavAgent& agent : navAgents)
+        agent.position = randomNavPoint();
+
+    GlfwPlayerInput playerInput(window);
+    FixedTimestep simulationStep(60.0f);
+    PlayerState previousPlayer = player;
+    std::vector<AABB> colliderBoxes;
+    std::vector<unsigned int> touchedColliders;
+
+    OcclusionCuller occlusion;
+    std::vector<ResidentEntity*> drawList;
+    std::vector<AABB> drawBounds;
+    std::vector<uint8_t> drawVisible;
+
+    // lights float over the whole streamed world; the last one is a headlight on the player
+    const unsigned int DEMO_LIGHT_COUNT = 2048;
+    std::vector<Light> lights = makeDemoLights(DEMO_LIGHT_COUNT, scene.ChunkSize * 4.0f);
+    std::vector<float> lightBaseHeights;
+    for (const Light& light : lights)
+        lightBaseHeights.push_back(light.position.y);
+    Light headlight;
+    headlight.type = LIGHT_SPOT;
+    headlight.color = glm::vec3(1.0f, 0.95f, 0.8f);
+    headlight.intensity = 6.0f;
+    headlight.range = 15.0f;
+    headlight.cosInner = std::cos(glm::radians(15.0f));
+    headlight.cosOuter = std::cos(glm::radians(25.0f));
+    lights.push_back(headlight);
+
+    ClusterSettings clusterSettings;
+    clusterSettings.nearPlane = 0.1f;
+    clusterSettings.farPlane = 100.0f;
+    ClusteredLighting lighting(clusterSettings);
 
-    
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+    // one ground tile; scenes place and scale it per chunk (20 units per texture repeat at the default chunk size)
     float planeVertices[] = {
         // positions          // normals       // texcoords
-         20.0f, 0.0f,  20.0f,  0.0f, 1.0f, 0.0f,  2.0f, 0.0f,
-        -20.0f, 0.0f,  20.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-        -20.0f, 0.0f, -20.0f,  0.0f, 1.0f, 0.0f,  0.0f, 2.0f,
+         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+        -0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
+        -0.5f, 0.0f, -0.5f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
 
-         20.0f, 0.0f,  20.0f,  0.0f, 1.0f, 0.0f,  2.0f, 0.0f,
-        -20.0f, 0.0f, -20.0f,  0.0f, 1.0f, 0.0f,  0.0f, 2.0f,
-         20.0f, 0.0f, -20.0f,  0.0f, 1.0f, 0.0f,  2.0f, 2.0f
+         0.5f, 0.0f,  0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f,
+        -0.5f, 0.0f, -0.5f,  0.0f, 1.0f, 0.0f,  0.0f, 1.0f,
+         0.5f, 0.0f, -0.5f,  0.0f, 1.0f, 0.0f,  1.0f, 1.0f
     };
-    unsigned int planeVAO, planeVBO;
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-
-    // position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // texcoords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glBindVertexArray(0);
-
-    unsigned int planeTexture;
-    glGenTextures(1, &planeTexture);
-    glBindTexture(GL_TEXTURE_2D, planeTexture);
-
-    // set the texture wrapping/filtering options (on currently bound texture)
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // load and generate the texture
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(FileSystem::getPath("resources/textures/marble.jpg").c_str(), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        GLenum format = GL_RGB;
-        if (nrChannels == 1)
-            format = GL_RED;
-        else if (nrChannels == 3)
-            format = GL_RGB;
-        else if (nrChannels == 4)
-            format = GL_RGBA;
-
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
+    PackingStats builtinPacking;
+    PackedMesh planeMesh(planeVertices, 6, &builtinPacking);
 
     float cubeVertices[] = {
         // positions          // normals           // texcoords
@@ -259,106 +328,128 @@ int main()
          -0.5f,  0.5f,  0.5f,  0.0f, 1.0f, 0.0f,   0.0f, 0.0f
     };
 
-    unsigned int cubeVAO, cubeVBO;
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
+    PackedMesh cubeMesh(cubeVertices, 36, &builtinPacking);
+    reportPacking("plane + cube", builtinPacking);
+    resources.Track(RESOURCE_MESH, "plane", 0, planeMesh.GpuBytes);
+    resources.Track(RESOURCE_MESH, "cube", 0, cubeMesh.GpuBytes);
 
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);
-
-    // position
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    // normal
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    // texcoords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-
-    glBindVertexArray(0);
-
-    unsigned int cubeTexture;
-    glGenTextures(1, &cubeTexture);
-    glBindTexture(GL_TEXTURE_2D, cubeTexture);
-
-    // ตั้งค่าการ wrap / filter
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    stbi_set_flip_vertically_on_load(true);
-    data = stbi_load(FileSystem::getPath("resources/textures/container2.png").c_str(), &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else
-    {
-        std::cout << "Failed to load cube texture" << std::endl;
-    }
-    stbi_image_free(data);
+    unsigned int cubeTexture = loadTexture(FileSystem::getPath("resources/textures/container2.png").c_str());
 
     ourShader.use();
     ourShader.setInt("texture_diffuse1", 0);
 
-    pillars[0].position = glm::vec3(7.0f, 3.0f, 0.0f);
-    pillars[0].scale = glm::vec3(0.5f, 2.0f, 0.5f);
-    pillars[0].color = glm::vec3(1.0f, 0.0f, 0.0f);
-    pillars[0].box.min = pillars[0].position - pillars[0].scale * 0.5f;
-    pillars[0].box.max = pillars[0].position + pillars[0].scale * 0.5f;
-
-    pillars[1].position = glm::vec3(-3.0f, 0.0f, 7.0f);
-    pillars[1].scale = glm::vec3(0.5f, 2.0f, 0.5f);
-    pillars[1].color = glm::vec3(1.0f, 0.0f, 0.0f);
-    pillars[1].box.min = pillars[1].position - pillars[1].scale * 0.5f;
-    pillars[1].box.max = pillars[1].position + pillars[1].scale * 0.5f;
-
-    pillars[2].position = glm::vec3(-1.0f, 4.0f, 7.0f);
-    pillars[2].scale = glm::vec3(0.5f, 2.0f, 0.5f);
-    pillars[2].color = glm::vec3(1.0f, 0.0f, 0.0f);
-    pillars[2].box.min = pillars[2].position - pillars[2].scale * 0.5f;
-    pillars[2].box.max = pillars[2].position + pillars[2].scale * 0.5f;
-
-    pillars[3].position = glm::vec3(9.0f, 2.0f, -7.0f);
-    pillars[3].scale = glm::vec3(0.5f, 2.0f, 0.5f);
-    pillars[3].color = glm::vec3(1.0f, 0.0f, 0.0f);
-    pillars[3].box.min = pillars[3].position - pillars[3].scale * 0.5f;
-    pillars[3].box.max = pillars[3].position + pillars[3].scale * 0.5f;
+    // memory budgets; crossing one prints a warning naming what could be evicted
+    resources.SetBudget(RESOURCE_TEXTURE, ResourceBudget{ 0, 64 * 1024 * 1024 });
+    resources.SetBudget(RESOURCE_MESH, ResourceBudget{ 64 * 1024 * 1024, 64 * 1024 * 1024 });
+    resources.SetBudget(RESOURCE_SCENE, ResourceBudget{ WorldStreamerSettings().maxResidentBytes, 0 });
+    resources.SetTotalBudget(ResourceBudget{ 256 * 1024 * 1024, 256 * 1024 * 1024 });
+    bool snapshotKeyDown = false;
+    unsigned int snapshotCount = 0;
+
+    float statsTime = 0.0f;
+
+    FramePacer framePacer(framePacing);
+    bool lateMouseKeyDown = false;
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
+        // frame pacing: wait for this frame's slot first, then poll IO events (keys pressed/released,
+        // mouse moved etc.), so the input is as fresh as it can be when the frame starts
+        // -----------------------------------------------------------------------------------------
+        framePacer.Wait();
+        glfwPollEvents();
+        framePacer.MarkInput();
+
         // per-frame time logic
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
+        // world streaming
+        // ---------------
+        streamer.Update(cubePosition);
+        colliders.clear();
+        for (const auto& chunk : streamer.ResidentChunks())
+            for (ResidentEntity& entity : chunk.second->entities)
+                if (entity.data.flags & SCENE_ENTITY_COLLIDER)
+                    colliders.push_back(&entity);
+
+        // memory: the streamed world's share changes as chunks come and go
+        resources.NextFrame();
+        resources.Update(streamedResource, streamer.ResidentBytes() + streamer.PendingBytes(), 0);
+        resources.CheckBudgets();
+
         // input
         // -----
         processInput(window);
+        bool snapshotKey = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+        if (snapshotKey && !snapshotKeyDown)
+        {
+            std::string snapshotPath = "resources_" + std::to_string(snapshotCount++) + ".json";
+            if (resources.WriteSnapshot(snapshotPath))
+                std::cout << "Wrote resource snapshot " << snapshotPath << std::endl;
+        }
+        snapshotKeyDown = snapshotKey;
+        bool lateMouseKey = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+        if (lateMouseKey && !lateMouseKeyDown)
+            lateMouseSampling = !lateMouseSampling;
+        lateMouseKeyDown = lateMouseKey;
+
+        // simulation: fixed ticks, so the result doesn't depend on the frame rate
+        // ----------
+        colliderBoxes.clear();
+        for (ResidentEntity* collider : colliders)
+            colliderBoxes.push_back(collider->data.collider);
+        PlayerInput input = playerInput.Poll();
+        for (unsigned int step = simulationStep.Advance(deltaTime); step > 0; step--)
+        {
+            previousPlayer = player;
+            touchedColliders.clear();
+            stepPlayer(player, input, playerSettings, colliderBoxes, simulationStep.Step, &touchedColliders);
+            for (unsigned int index : touchedColliders)
+                colliders[index]->color = glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+        cubePosition = glm::mix(previousPlayer.position, player.position, simulationStep.Alpha());
 
-        cubeVelocityY += gravity * deltaTime;
-        cubePosition.y += cubeVelocityY * deltaTime;
-
-        float cubeHalfHeight = 0.5f;
-        float groundY = 0.0f;
-
-        if (cubePosition.y <= groundY + cubeHalfHeight)
+        // navigation: agents that arrived ask for a new destination, then everyone walks
+        // ----------
+        for (NavAgent& agent : navAgents)
         {
-            cubePosition.y = groundY + cubeHalfHeight;
-            cubeVelocityY = 0.0f;
-            isOnGround = true;
+            if (agent.waiting && pathQueue.Status(agent.request) != PATH_PENDING)
+            {
+                agent.waypoints = pathQueue.Waypoints(agent.request);
+                agent.next = 0;
+                agent.waiting = false;
+                pathQueue.Release(agent.request);
+            }
+            else if (!agent.waiting && agent.next >= agent.waypoints.size())
+            {
+                agent.request = pathQueue.Request(agent.position, randomNavPoint());
+                agent.waiting = true;
+            }
         }
-        else
+        pathQueue.Update(jobs, 1.0f);
+        for (NavAgent& agent : navAgents)
         {
-            isOnGround = false;
+            float step = NAV_AGENT_SPEED * deltaTime;
+            while (step > 0.0f && agent.next < agent.waypoints.size())
+            {
+                glm::vec3 toWaypoint = agent.waypoints[agent.next] - agent.position;
+                float distance = glm::length(toWaypoint);
+                if (distance <= step)
+                {
+                    agent.position = agent.waypoints[agent.next++];
+                    step -= distance;
+                }
+                else
+                {
+                    agent.position += toWaypoint * (step / distance);
+                    step = 0.0f;
+                }
+            }
         }
 
         // render
@@ -371,6 +462,17 @@ int main()
         float distanceBehind = 3.0f;
         float heightOffset = 0.5f;
 
+        // late input: whatever the mouse did while this frame simulated still makes it into the view.
+        // With the cursor disabled GLFW only moves it while polling, so poll again and let the
+        // callback apply it; the input time only moves when there was movement to apply
+        if (lateMouseSampling)
+        {
+            float seenX = lastX, seenY = lastY;
+            glfwPollEvents();
+            if (lastX != seenX || lastY != seenY)
+                framePacer.MarkInput();
+        }
+
         float yawRad = glm::radians(cubeYaw);
         float pitchRad = glm::radians(cameraPitch);
 
@@ -384,30 +486,103 @@ int main()
         camera.Front = glm::normalize(cubePosition - camera.Position);
 
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT,
+                                                clusterSettings.nearPlane, clusterSettings.farPlane);
         glm::mat4 view = camera.GetViewMatrix();
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
 
-        // render plane with texture
-        glm::mat4 modelPlane = glm::mat4(1.0f);
-        ourShader.setMat4("model", modelPlane);
-        ourShader.setBool("useTexture", true);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, planeTexture);
-        ourShader.setInt("texture1", 0);
-        glBindVertexArray(planeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(1.0f));
-        ourShader.setMat4("model", model);
-        ourShader.setVec3("objectColor", glm::vec3(1.0f, 1.0f, 1.0f));
-        ourShader.setBool("useTexture", true);
-        ourModel.Draw(ourShader);
+        // lighting: animate, bin into clusters on the workers, upload
+        for (unsigned int i = 0; i < DEMO_LIGHT_COUNT; i++)
+            lights[i].position.y = lightBaseHeights[i] + 0.5f * sin(currentFrame * 1.5f + i);
+        Light& playerLight = lights.back();
+        playerLight.position = cubePosition + glm::vec3(0.0f, 0.8f, 0.0f);
+        playerLight.direction = glm::normalize(glm::vec3(-sin(yawRad), -0.35f, -cos(yawRad)));
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        lighting.Update(lights, view, projection, jobs);
+        lighting.Bind(ourShader, framebufferWidth, framebufferHeight);
+
+        // occlusion: rasterize the occluders on the CPU, then keep only entities whose bounds may show
+        occlusion.BeginFrame(projection * view);
+        drawList.clear();
+        drawBounds.clear();
+        for (const auto& chunk : streamer.ResidentChunks())
+        {
+            for (ResidentEntity& entity : chunk.second->entities)
+            {
+                if (entity.data.flags & SCENE_ENTITY_OCCLUDER)
+                {
+                    const SceneMesh& mesh = scene.Meshes[entity.data.mesh];
+                    if (mesh.type == SCENE_MESH_MODEL)
+                    {
+                        glm::mat4 model = glm::mat4(1.0f);
+                        model = glm::translate(model, entity.data.position);
+                        model = glm::rotate(model, glm::radians(entity.data.yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+                        model = glm::scale(model, entity.data.scale);
+                        const LodModel& lods = *sceneLods[entity.data.mesh];
+                        occlusion.AddOccluder(lods.OccluderPositions, lods.OccluderIndices, model);
+                    }
+                    else if (mesh.type == SCENE_MESH_CUBE)
+                    {
+                        occlusion.AddOccluderBox(sceneEntityBounds(entity.data));
+                    }
+                }
+                drawList.push_back(&entity);
+                drawBounds.push_back(sceneEntityBounds(entity.data));
+            }
+        }
+        occlusion.Rasterize(jobs);
+        occlusion.TestBoxes(drawBounds, drawVisible, jobs);
+
+        // render the visible entities of the resident chunks
+        LodStats lodStats;
+        for (size_t i = 0; i < drawList.size(); i++)
+        {
+            if (!drawVisible[i])
+                continue;
+            ResidentEntity& entity = *drawList[i];
+            const SceneMesh& mesh = scene.Meshes[entity.data.mesh];
+            const SceneMaterial& material = scene.Materials[entity.data.material];
+
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model, entity.data.position);
+            model = glm::rotate(model, glm::radians(entity.data.yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = glm::scale(model, entity.data.scale);
+            ourShader.setMat4("model", model);
+            ourShader.setVec3("objectColor", entity.color);
+            ourShader.setBool("useTexture", (material.flags & SCENE_MATERIAL_TEXTURED) != 0);
+            if (!material.texturePath.empty())
+            {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, sceneTextures[material.texturePath]);
+                resources.Touch(sceneTextureResources[material.texturePath]);
+            }
+
+            if (mesh.type == SCENE_MESH_MODEL)
+            {
+                LodModel& lods = *sceneLods[entity.data.mesh];
+                entity.lodLevel = lods.SelectLevel(model, camera.Position, glm::radians(camera.Zoom), entity.lodLevel);
+                lods.Draw(ourShader, entity.lodLevel, &lodStats);
+            }
+            else if (mesh.type == SCENE_MESH_PLANE)
+            {
+                planeMesh.Draw(ourShader);
+            }
+            else
+            {
+                cubeMesh.Draw(ourShader);
+            }
+        }
+
+        ourShader.setVec3("objectColor", glm::vec3(1.0f, 0.6f, 0.1f));
+        ourShader.setBool("useTexture", false);
+        for (const NavAgent& agent : navAgents)
+        {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), agent.position + glm::vec3(0.0f, 0.2f, 0.0f));
+            ourShader.setMat4("model", glm::scale(model, glm::vec3(0.4f)));
+            cubeMesh.Draw(ourShader);
+        }
 
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, cubeTexture);
@@ -419,32 +594,43 @@ int main()
         ourShader.setMat4("model", modelCube);
 
         ourShader.setBool("useTexture", true);
-        glBindVertexArray(cubeVAO);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
+        cubeMesh.Draw(ourShader);
 
-        for (int i = 0; i < 4; i++)
+        // once a second, show what LOD selection and occlusion culling saved in the window title
+        if (currentFrame - statsTime >= 1.0f)
         {
-            glm::mat4 modelPillar = glm::mat4(1.0f);
-            modelPillar = glm::translate(modelPillar, pillars[i].position);
-            modelPillar = glm::scale(modelPillar, pillars[i].scale);
-            ourShader.setMat4("model", modelPillar);
-
-            ourShader.setBool("useTexture", false);
-            ourShader.setVec3("objectColor", pillars[i].color);
-
-            glBindVertexArray(cubeVAO);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
+            const OcclusionStats& culling = occlusion.Stats();
+            const FramePacerStats& pacing = framePacer.Stats();
+            std::string title = "LearnOpenGL | model triangles " + std::to_string(lodStats.submittedTriangles) +
+                " / " + std::to_string(lodStats.fullTriangles) + " at full detail | culled " +
+                std::to_string(static_cast<int>(culling.CulledPercent())) + "% of " + std::to_string(culling.tested) +
+                " (" + std::to_string(culling.occluded) + " occluded) in " +
+                std::to_string(static_cast<int>((culling.rasterizeMs + culling.testMs) * 1000.0f)) + " us | lights " +
+                std::to_string(lighting.Stats().visibleLights) + " / " + std::to_string(lighting.Stats().lights) + " binned in " +
+                std::to_string(static_cast<int>(lighting.Stats().buildMs * 1000.0f)) + " us | paths " +
+                std::to_string(pathQueue.Stats().processed) + " (" + std::to_string(pathQueue.Stats().pending) + " queued) in " +
+                std::to_string(static_cast<int>(pathQueue.Stats().updateMs * 1000.0f)) + " us | memory CPU " +
+                formatBytes(resources.Total().cpuBytes) + ", GPU " + formatBytes(resources.Total().gpuBytes) + " | " +
+                std::to_string(pacing.frames) + " fps (cap " + std::to_string(static_cast<int>(framePacing.targetFps)) + "), work " +
+                std::to_string(static_cast<int>(pacing.workMs * 1000.0f)) + " us, input latency " +
+                std::to_string(static_cast<int>(pacing.latencyMs * 1000.0f)) + " us mean " +
+                std::to_string(static_cast<int>(pacing.latencyP99Ms * 1000.0f)) + " us p99" + (lateMouseSampling ? " (late mouse)" : "");
+            glfwSetWindowTitle(window, title.c_str());
+            statsTime = currentFrame;
         }
 
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
+        // glfw: swap buffers; IO events are polled at the start of the next frame, after its wait
+        // ---------------------------------------------------------------------------------------
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        framePacer.MarkPresented();
     }
 
+    // optional: de-allocate all resources once they've outlived their purpose; the context goes with glfwTerminate
+    // ------------------------------------------------------------------------------------------------------
+    planeMesh.Release();
+    cubeMesh.Release();
+    sceneLods.clear();
+
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
@@ -457,98 +643,6 @@ void processInput(GLFWwindow* window)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
-
-    float velocity = cubeSpeed * deltaTime;
-    float yawRad = glm::radians(cubeYaw);
-
-    glm::vec3 forward(-sin(yawRad), 0.0f, -cos(yawRad));
-    glm::vec3 right(cos(yawRad), 0.0f, -sin(yawRad));
-
-    glm::vec3 newPos = cubePosition;
-    float cubeHalfSize = 0.5f;
-
-    cubeVelocityY += gravity * deltaTime;
-    glm::vec3 tempPosY = newPos + glm::vec3(0.0f, cubeVelocityY * deltaTime, 0.0f);
-    AABB cubeBoxY{ tempPosY - glm::vec3(cubeHalfSize), tempPosY + glm::vec3(cubeHalfSize) };
-
-    for (int i = 0; i < 4; i++)
-    {
-        if (checkCollisionAABB(cubeBoxY, pillars[i].box))
-        {
-            pillars[i].color = glm::vec3(0.0f, 1.0f, 0.0f);
-
-            if (cubeVelocityY < 0.0f)
-            {
-                tempPosY.y = pillars[i].box.max.y + cubeHalfSize;
-                cubeVelocityY = 0.0f;
-                isOnGround = true;
-            }
-            else if (cubeVelocityY > 0.0f)
-            {
-                tempPosY.y = pillars[i].box.min.y - cubeHalfSize;
-                cubeVelocityY = 0.0f;
-            }
-        }
-    }
-
-    if (checkCollisionAABB(cubeBoxY, rockBox))
-    {
-        if (cubeVelocityY < 0.0f)
-        {
-            tempPosY.y = rockBox.max.y + cubeHalfSize;
-            cubeVelocityY = 0.0f;
-            isOnGround = true;
-        }
-        else if (cubeVelocityY > 0.0f)
-        {
-            tempPosY.y = rockBox.min.y - cubeHalfSize;
-            cubeVelocityY = 0.0f;
-        }
-    }
-
-    newPos.y = tempPosY.y;
-
-    glm::vec3 move(0.0f);
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) move += forward * velocity;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) move -= forward * velocity;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) move -= right * velocity;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) move += right * velocity;
-
-    glm::vec3 tempPosX = newPos + glm::vec3(move.x, 0.0f, 0.0f);
-    AABB cubeBoxX{ tempPosX - glm::vec3(cubeHalfSize), tempPosX + glm::vec3(cubeHalfSize) };
-    bool collisionX = checkCollisionAABB(cubeBoxX, rockBox);
-    for (int i = 0; i < 4; i++)
-        if (checkCollisionAABB(cubeBoxX, pillars[i].box))
-        {
-            if (tempPosY.y - cubeHalfSize < pillars[i].box.max.y - 0.01f)
-            {
-                pillars[i].color = glm::vec3(0.0f, 1.0f, 0.0f);
-                collisionX = true;
-            }
-        }
-    if (!collisionX) newPos.x += move.x;
-
-    glm::vec3 tempPosZ = newPos + glm::vec3(0.0f, 0.0f, move.z);
-    AABB cubeBoxZ{ tempPosZ - glm::vec3(cubeHalfSize), tempPosZ + glm::vec3(cubeHalfSize) };
-    bool collisionZ = checkCollisionAABB(cubeBoxZ, rockBox);
-    for (int i = 0; i < 4; i++)
-        if (checkCollisionAABB(cubeBoxZ, pillars[i].box))
-        {
-            if (tempPosY.y - cubeHalfSize < pillars[i].box.max.y - 0.01f)
-            {
-                pillars[i].color = glm::vec3(0.0f, 1.0f, 0.0f);
-                collisionZ = true;
-            }
-        }
-    if (!collisionZ) newPos.z += move.z;
-
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && isOnGround)
-    {
-        cubeVelocityY = 5.0f;
-        isOnGround = false;
-    }
-
-    cubePosition = newPos;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -564,10 +658,12 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
 {
-    static float lastX = SCR_WIDTH / 2.0f;
-    static float lastY = SCR_HEIGHT / 2.0f;
-    static bool firstMouse = true;
+    applyMouseMovement(xposIn, yposIn);
+}
 
+// turns the cursor position into yaw and pitch, measured from the last position seen
+void applyMouseMovement(double xposIn, double yposIn)
+{
     float xpos = static_cast<float>(xposIn);
     float ypos = static_cast<float>(yposIn);
 
@@ -602,3 +698,141 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
+
+// utility function for loading a 2D texture from file
+// ---------------------------------------------------
+unsigned int loadTexture(char const* path)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    int width, height, nrComponents;
+    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format = GL_RGB;
+        if (nrComponents == 1)
+            format = GL_RED;
+        else if (nrComponents == 3)
+            format = GL_RGB;
+        else if (nrComponents == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    }
+    stbi_image_free(data);
+    trackTexture(resources, path, textureID);
+
+    return textureID;
+}
+
+// coloured point lights scattered over [-extent, extent] on x and z, hovering above the ground
+// ---------------------------------------------------------------------------------------
+std::vector<Light> makeDemoLights(unsigned int count, float extent)
+{
+    unsigned int seed = 4242u;
+    auto random01 = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+
+    std::vector<Light> lights(count);
+    for (Light& light : lights)
+    {
+        light.type = LIGHT_POINT;
+        light.position = glm::vec3((random01() * 2.0f - 1.0f) * extent, 0.75f + random01() * 2.0f, (random01() * 2.0f - 1.0f) * extent);
+        light.color = glm::vec3(0.3f + 0.7f * random01(), 0.3f + 0.7f * random01(), 0.3f + 0.7f * random01());
+        light.intensity = 2.0f + random01() * 2.0f;
+        light.range = 3.0f + random01() * 4.0f;
+    }
+    return lights;
+}
+
+// cooks the original hand-placed level (ground, rock, four pillars) into a chunked scene file,
+// surrounded by a ring of generated chunks so there is something to stream in and out
+// ---------------------------------------------------------------------------------------
+bool cookDefaultScene(const std::string& path)
+{
+    SceneDescription scene;
+    scene.chunkSize = 20.0f;
+    scene.meshes = {
+        { SCENE_MESH_CUBE, "" },
+        { SCENE_MESH_PLANE, "" },
+        { SCENE_MESH_MODEL, "resources/objects/rock/rock.obj" }
+    };
+    const uint32_t cubeMesh = 0, planeMesh = 1, rockMesh = 2;
+    scene.materials = {
+        { glm::vec3(1.0f), SCENE_MATERIAL_TEXTURED, "resources/textures/marble.jpg" },
+        { glm::vec3(1.0f, 0.0f, 0.0f), 0, "" },
+        { glm::vec3(1.0f), SCENE_MATERIAL_TEXTURED, "" }    // the model binds its own textures
+    };
+    const uint32_t groundMaterial = 0, pillarMaterial = 1, rockMaterial = 2;
+
+    auto addPillar = [&](const glm::vec3& position, const glm::vec3& scale) {
+        SceneEntity pillar{ position, scale, 0.0f, cubeMesh, pillarMaterial, SCENE_ENTITY_COLLIDER | SCENE_ENTITY_OCCLUDER,
+                            AABB{ position - scale * 0.5f, position + scale * 0.5f } };
+        scene.entities.push_back(pillar);
+    };
+
+    // the rock's collider is baked from its mesh so nothing downstream needs the model to collide with it
+    Model rock(FileSystem::getPath(scene.meshes[rockMesh].path));
+    AABB rockBox{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+    for (unsigned int i = 0; i < rock.meshes.size(); i++)
+        for (unsigned int v = 0; v < rock.meshes[i].vertices.size(); v++)
+        {
+            rockBox.min = glm::min(rockBox.min, rock.meshes[i].vertices[v].Position);
+            rockBox.max = glm::max(rockBox.max, rock.meshes[i].vertices[v].Position);
+        }
+    scene.entities.push_back(SceneEntity{ glm::vec3(0.0f), glm::vec3(1.0f), 0.0f, rockMesh, rockMaterial,
+                                          SCENE_ENTITY_COLLIDER | SCENE_ENTITY_OCCLUDER, rockBox });
+
+    addPillar(glm::vec3(7.0f, 3.0f, 0.0f), glm::vec3(0.5f, 2.0f, 0.5f));
+    addPillar(glm::vec3(-3.0f, 0.0f, 7.0f), glm::vec3(0.5f, 2.0f, 0.5f));
+    addPillar(glm::vec3(-1.0f, 4.0f, 7.0f), glm::vec3(0.5f, 2.0f, 0.5f));
+    addPillar(glm::vec3(9.0f, 2.0f, -7.0f), glm::vec3(0.5f, 2.0f, 0.5f));
+
+    // 8x8 chunks of ground; the four in the middle are the original 40x40 plane
+    unsigned int seed = 1337u;
+    auto random01 = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+    const int worldRadius = 4;
+    for (int z = -worldRadius; z < worldRadius; z++)
+    {
+        for (int x = -worldRadius; x < worldRadius; x++)
+        {
+            glm::vec3 origin(x * scene.chunkSize, 0.0f, z * scene.chunkSize);
+            glm::vec3 center = origin + glm::vec3(scene.chunkSize * 0.5f, 0.0f, scene.chunkSize * 0.5f);
+            scene.entities.push_back(SceneEntity{ center, glm::vec3(scene.chunkSize, 1.0f, scene.chunkSize), 0.0f,
+                                                  planeMesh, groundMaterial, 0, AABB{ center, center } });
+
+            if (x >= -1 && x <= 0 && z >= -1 && z <= 0)
+                continue;
+            for (int i = 0; i < 3; i++)
+            {
+                float height = 1.0f + random01() * 4.0f;
+                glm::vec3 position = origin + glm::vec3(2.0f + random01() * (scene.chunkSize - 4.0f), height * 0.5f,
+                                                        2.0f + random01() * (scene.chunkSize - 4.0f));
+                addPillar(position, glm::vec3(0.5f, height, 0.5f));
+            }
+        }
+    }
+
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path());
+    if (!writeSceneFile(path, scene))
+        return false;
+    std::cout << "Cooked default scene (" << scene.entities.size() << " entities) to " << path << std::endl;
+    return true;
+}
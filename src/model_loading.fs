@@ -2,15 +2,17 @@
 out vec4 FragColor;
 
 in vec2 TexCoords;
+in vec3 ViewPos;
+in vec3 ViewNormal;
 
 uniform sampler2D texture_diffuse1;
 uniform vec3 objectColor;
 uniform bool useTexture;
 
+#include "clustered_lighting.glsl"
+
 void main()
 {
-    if(useTexture)
-        FragColor = texture(texture_diffuse1, TexCoords);
-    else
-        FragColor = vec4(objectColor, 1.0);
+    vec4 albedo = useTexture ? texture(texture_diffuse1, TexCoords) : vec4(objectColor, 1.0);
+    FragColor = vec4(shadeClusteredLights(albedo.rgb, ViewPos, normalize(ViewNormal)), albedo.a);
 }
@@ -1,16 +1,31 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+layout (location = 1) in vec2 aNormal;  // octahedral encoded, see vertex_packing.h
 layout (location = 2) in vec2 aTexCoords;
 
 out vec2 TexCoords;
+out vec3 ViewPos;
+out vec3 ViewNormal;
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    mat4 viewModel = view * model;
+    vec4 viewPosition = viewModel * vec4(aPos, 1.0);
+    ViewPos = viewPosition.xyz;
+    // lighting is done in view space, see clustered_lighting.h
+    ViewNormal = mat3(transpose(inverse(viewModel))) * octDecode(aNormal);
+    gl_Position = projection * viewPosition;
 }
@@ -0,0 +1,910 @@
+#ifndef NAVIGATION_H
+#define NAVIGATION_H
+
+#include <glm/glm.hpp>
+
+#include "collision.h"
+#include "job_system.h"
+#include "scene_format.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+struct NavigationSettings {
+    float cellSize = 0.25f;
+    float agentRadius = 0.3f;           // obstacles are grown by this, so paths keep the agent's body clear
+    float agentHeight = 1.8f;           // obstacles starting above this are walked under
+    float maxStepHeight = 0.3f;         // obstacles lower than this are stepped over
+    unsigned int clusterSize = 16;      // cells per side of a cluster in the abstract graph
+    unsigned int maxEntranceWidth = 6;  // wider border openings get a transition at each end instead of one in the middle
+};
+
+// The walkable area as a grid on the ground plane. Cells are walkable where ground covers them
+// and no obstacle (grown by the agent radius) stands in the agent's height range.
+class NavigationGrid
+{
+public:
+    glm::vec2 Origin = glm::vec2(0.0f);     // x/z of the corner of cell (0, 0)
+    float CellSize = 1.0f;
+    float GroundY = 0.0f;
+    int Width = 0;
+    int Height = 0;
+    std::vector<uint8_t> Walkable;
+
+    // covers min..max on x/z, everything blocked until ground is added
+    void Reset(const glm::vec2& min, const glm::vec2& max, float cellSize, float groundY)
+    {
+        Origin = min;
+        CellSize = cellSize;
+        GroundY = groundY;
+        Width = std::max(1, static_cast<int>(std::ceil((max.x - min.x) / cellSize)));
+        Height = std::max(1, static_cast<int>(std::ceil((max.y - min.y) / cellSize)));
+        Walkable.assign(static_cast<size_t>(Width) * Height, 0);
+    }
+
+    void AddGround(const AABB& area) { fill(area.min, area.max, 1); }
+
+    void AddObstacle(const AABB& box, const NavigationSettings& settings)
+    {
+        if (box.max.y <= GroundY + settings.maxStepHeight || box.min.y >= GroundY + settings.agentHeight)
+            return;
+        glm::vec3 grow(settings.agentRadius, 0.0f, settings.agentRadius);
+        fill(box.min - grow, box.max + grow, 0);
+    }
+
+    bool IsWalkable(int x, int z) const
+    {
+        return x >= 0 && z >= 0 && x < Width && z < Height && Walkable[static_cast<size_t>(z) * Width + x] != 0;
+    }
+
+    glm::ivec2 CellAt(const glm::vec3& position) const
+    {
+        return glm::ivec2(static_cast<int>(std::floor((position.x - Origin.x) / CellSize)),
+                          static_cast<int>(std::floor((position.z - Origin.y) / CellSize)));
+    }
+
+    glm::vec3 CellCenter(int x, int z) const
+    {
+        return glm::vec3(Origin.x + (x + 0.5f) * CellSize, GroundY, Origin.y + (z + 0.5f) * CellSize);
+    }
+
+    size_t MemoryBytes() const { return Walkable.capacity(); }
+
+private:
+    // cells whose centres lie inside min..max
+    void fill(const glm::vec3& min, const glm::vec3& max, uint8_t value)
+    {
+        int x0 = std::max(0, static_cast<int>(std::ceil((min.x - Origin.x) / CellSize - 0.5f)));
+        int z0 = std::max(0, static_cast<int>(std::ceil((min.z - Origin.y) / CellSize - 0.5f)));
+        int x1 = std::min(Width - 1, static_cast<int>(std::floor((max.x - Origin.x) / CellSize - 0.5f)));
+        int z1 = std::min(Height - 1, static_cast<int>(std::floor((max.z - Origin.y) / CellSize - 0.5f)));
+        for (int z = z0; z <= z1; z++)
+            for (int x = x0; x <= x1; x++)
+                Walkable[static_cast<size_t>(z) * Width + x] = value;
+    }
+};
+
+// ground planes make the walkable area, colliders cut holes in it; reads every chunk of the scene
+inline void buildNavigationGrid(const SceneFile& scene, const NavigationSettings& settings, NavigationGrid& grid)
+{
+    std::vector<AABB> ground, obstacles;
+    std::vector<SceneEntity> entities;
+    glm::vec2 min(FLT_MAX), max(-FLT_MAX);
+    float groundY = 0.0f;
+    for (unsigned int chunk = 0; chunk < scene.Chunks.size(); chunk++)
+    {
+        scene.LoadChunk(static_cast<int>(chunk), entities);
+        for (const SceneEntity& entity : entities)
+        {
+            if (scene.Meshes[entity.mesh].type == SCENE_MESH_PLANE)
+            {
+                glm::vec3 half = entity.scale * 0.5f;
+                ground.push_back(AABB{ entity.position - half, entity.position + half });
+                min = glm::min(min, glm::vec2(entity.position.x - half.x, entity.position.z - half.z));
+                max = glm::max(max, glm::vec2(entity.position.x + half.x, entity.position.z + half.z));
+                groundY = entity.position.y;
+            }
+            if (entity.flags & SCENE_ENTITY_COLLIDER)
+                obstacles.push_back(entity.collider);
+        }
+    }
+    if (ground.empty())
+        return;
+    grid.Reset(min, max, settings.cellSize, groundY);
+    for (const AABB& area : ground)
+        grid.AddGround(area);
+    for (const AABB& box : obstacles)
+        grid.AddObstacle(box, settings);
+}
+
+// per-thread working memory for path searches; reused between queries so they don't allocate
+struct PathScratch {
+    struct OpenEntry {
+        float f;
+        float g;
+        uint32_t index;
+        bool operator>(const OpenEntry& other) const { return f > other.f; }
+    };
+
+    // cell search inside one cluster, indexed by cell within the cluster
+    std::vector<float> cellCost;
+    std::vector<uint32_t> cellParent;
+    std::vector<uint32_t> cellStamp;
+    uint32_t cellGeneration = 0;
+    // abstract search, indexed by graph node
+    std::vector<float> nodeCost;
+    std::vector<uint32_t> nodeParent;
+    std::vector<uint32_t> nodeStamp;
+    std::vector<float> goalCost;
+    std::vector<uint32_t> goalStamp;
+    uint32_t nodeGeneration = 0;
+    std::vector<OpenEntry> open;
+    std::vector<uint32_t> nodePath;
+    std::vector<uint32_t> cellPath;
+    std::vector<uint32_t> segment;
+    unsigned long long expanded = 0;    // cells plus nodes, since the scratch was made
+
+    // where a search cut short by its deadline stopped, for ContinuePath
+    enum Stage { SEARCH_IDLE, SEARCH_ABSTRACT, SEARCH_REFINE, SEARCH_STRAIGHTEN };
+    Stage stage = SEARCH_IDLE;
+    glm::vec3 start = glm::vec3(0.0f);
+    glm::vec3 goal = glm::vec3(0.0f);
+    uint32_t startCell = 0;
+    uint32_t goalCell = 0;
+    float bestGoal = 0.0f;      // abstract search: cheapest way to the goal so far, through bestLast
+    uint32_t bestLast = 0;
+    size_t step = 0;            // next entry of nodePath while refining, the anchor while straightening
+    uint32_t cell = 0;          // cell the refinement has reached
+};
+
+enum PathStatus {
+    PATH_PENDING,
+    PATH_FOUND,
+    PATH_NOT_FOUND
+};
+
+struct NavigationStats {
+    int width = 0;
+    int height = 0;
+    unsigned int walkableCells = 0;
+    unsigned int clusters = 0;
+    unsigned int nodes = 0;
+    unsigned int edges = 0;
+    size_t gridBytes = 0;
+    size_t graphBytes = 0;
+    float buildMs = 0.0f;
+};
+
+// Hierarchical A* (HPA*) over a NavigationGrid. The grid is cut into square clusters; cells on
+// either side of each open stretch of a cluster border become graph nodes, and the cost between
+// every pair of nodes in the same cluster is found once at build time and cached. A query
+// searches this small graph, then only the clusters along the result are searched cell by cell.
+// Paths are a few percent longer than optimal in exchange for touching a tiny part of the grid.
+// FindPath is const; give each thread its own PathScratch. StartPath and ContinuePath split a
+// query over several calls, each stopping at a deadline.
+class HierarchicalPathfinder
+{
+public:
+    HierarchicalPathfinder(const NavigationGrid& grid, const NavigationSettings& settings = NavigationSettings())
+        : m_Grid(grid), m_ClusterSize(static_cast<int>(settings.clusterSize)), m_MaxEntranceWidth(static_cast<int>(settings.maxEntranceWidth))
+    {
+    }
+
+    const NavigationGrid& Grid() const { return m_Grid; }
+    const NavigationStats& Stats() const { return m_Stats; }
+
+    // (re)builds the abstract graph; the intra-cluster costs are searched in parallel
+    void Build(JobSystem& jobs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        m_Nodes.clear();
+        m_ClusterNodeStart.clear();
+        m_Stats = NavigationStats();
+        if (m_Grid.Walkable.empty())
+            return;
+        m_ClustersX = (m_Grid.Width + m_ClusterSize - 1) / m_ClusterSize;
+        m_ClustersZ = (m_Grid.Height + m_ClusterSize - 1) / m_ClusterSize;
+        std::unordered_map<uint32_t, uint32_t> nodeOfCell;
+        std::vector<std::vector<Edge>> adjacency;
+        auto nodeAt = [&](int x, int z) {
+            uint32_t cell = static_cast<uint32_t>(z * m_Grid.Width + x);
+            auto found = nodeOfCell.find(cell);
+            if (found != nodeOfCell.end())
+                return found->second;
+            uint32_t node = static_cast<uint32_t>(m_Nodes.size());
+            m_Nodes.push_back(Node{ cell, static_cast<uint32_t>(clusterOf(x, z)) });
+            adjacency.emplace_back();
+            nodeOfCell[cell] = node;
+            return node;
+        };
+        auto connect = [&](int ax, int az, int bx, int bz) {
+            uint32_t a = nodeAt(ax, az), b = nodeAt(bx, bz);
+            adjacency[a].push_back(Edge{ b, 1.0f });
+            adjacency[b].push_back(Edge{ a, 1.0f });
+        };
+
+        // entrances: stretches of border where both sides are walkable
+        for (int cz = 0; cz < m_ClustersZ; cz++)
+        {
+            for (int cx = 0; cx < m_ClustersX; cx++)
+            {
+                int x0 = cx * m_ClusterSize, z0 = cz * m_ClusterSize;
+                int x1 = std::min(m_Grid.Width, x0 + m_ClusterSize), z1 = std::min(m_Grid.Height, z0 + m_ClusterSize);
+                if (x1 < m_Grid.Width)
+                    scanBorder(z0, z1, [&](int z) { return m_Grid.IsWalkable(x1 - 1, z) && m_Grid.IsWalkable(x1, z); },
+                               [&](int z) { connect(x1 - 1, z, x1, z); });
+                if (z1 < m_Grid.Height)
+                    scanBorder(x0, x1, [&](int x) { return m_Grid.IsWalkable(x, z1 - 1) && m_Grid.IsWalkable(x, z1); },
+                               [&](int x) { connect(x, z1 - 1, x, z1); });
+            }
+        }
+
+        // nodes grouped by cluster
+        unsigned int clusterCount = static_cast<unsigned int>(m_ClustersX * m_ClustersZ);
+        m_ClusterNodeStart.assign(clusterCount + 1, 0);
+        for (const Node& node : m_Nodes)
+            m_ClusterNodeStart[node.cluster + 1]++;
+        for (unsigned int i = 0; i < clusterCount; i++)
+            m_ClusterNodeStart[i + 1] += m_ClusterNodeStart[i];
+        m_ClusterNodes.resize(m_Nodes.size());
+        std::vector<uint32_t> cursor(m_ClusterNodeStart.begin(), m_ClusterNodeStart.end() - 1);
+        for (uint32_t i = 0; i < m_Nodes.size(); i++)
+            m_ClusterNodes[cursor[m_Nodes[i].cluster]++] = i;
+
+        // cached intra-cluster costs: one Dijkstra per node, bounded to its cluster
+        std::vector<std::vector<Edge>> intra(m_Nodes.size());
+        jobs.ParallelFor(clusterCount, [&](unsigned int cluster) {
+            PathScratch scratch;
+            for (uint32_t i = m_ClusterNodeStart[cluster]; i < m_ClusterNodeStart[cluster + 1]; i++)
+            {
+                uint32_t from = m_ClusterNodes[i];
+                searchCluster(cluster, m_Nodes[from].cell, UINT32_MAX, scratch);
+                for (uint32_t j = m_ClusterNodeStart[cluster]; j < m_ClusterNodeStart[cluster + 1]; j++)
+                {
+                    uint32_t to = m_ClusterNodes[j];
+                    float cost = reachedCost(cluster, m_Nodes[to].cell, scratch);
+                    if (to != from && cost < FLT_MAX)
+                        intra[from].push_back(Edge{ to, cost });
+                }
+            }
+        });
+
+        m_EdgeStart.assign(m_Nodes.size() + 1, 0);
+        m_Edges.clear();
+        for (uint32_t i = 0; i < m_Nodes.size(); i++)
+        {
+            m_Edges.insert(m_Edges.end(), adjacency[i].begin(), adjacency[i].end());
+            m_Edges.insert(m_Edges.end(), intra[i].begin(), intra[i].end());
+            m_EdgeStart[i + 1] = static_cast<uint32_t>(m_Edges.size());
+        }
+
+        m_Stats.width = m_Grid.Width;
+        m_Stats.height = m_Grid.Height;
+        for (uint8_t walkable : m_Grid.Walkable)
+            m_Stats.walkableCells += walkable;
+        m_Stats.clusters = clusterCount;
+        m_Stats.nodes = static_cast<unsigned int>(m_Nodes.size());
+        m_Stats.edges = static_cast<unsigned int>(m_Edges.size());
+        m_Stats.gridBytes = m_Grid.MemoryBytes();
+        m_Stats.graphBytes = m_Nodes.capacity() * sizeof(Node) + m_Edges.capacity() * sizeof(Edge) +
+                             (m_EdgeStart.capacity() + m_ClusterNodeStart.capacity() + m_ClusterNodes.capacity()) * sizeof(uint32_t);
+        m_Stats.buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Waypoints from start to goal on the ground, straightened where the way is clear; the last
+    // is the goal itself. Start or goal inside an obstacle snaps to the nearest walkable cell.
+    bool FindPath(const glm::vec3& start, const glm::vec3& goal, PathScratch& scratch, std::vector<glm::vec3>& waypoints) const
+    {
+        return StartPath(start, goal, scratch, waypoints, std::chrono::steady_clock::time_point::max()) == PATH_FOUND;
+    }
+
+    // As FindPath, but returns PATH_PENDING once the deadline passes, with the search kept in
+    // scratch; ContinuePath with the same scratch and waypoints carries on from there. The clock
+    // is read every 64 expanded nodes and after each cluster refined or waypoint placed.
+    PathStatus StartPath(const glm::vec3& start, const glm::vec3& goal, PathScratch& scratch, std::vector<glm::vec3>& waypoints,
+                         std::chrono::steady_clock::time_point deadline) const
+    {
+        waypoints.clear();
+        scratch.stage = PathScratch::SEARCH_IDLE;
+        uint32_t startCell, goalCell;
+        if (m_ClusterNodeStart.empty())
+            return PATH_NOT_FOUND;
+        if (!nearestWalkable(m_Grid.CellAt(start), startCell) || !nearestWalkable(m_Grid.CellAt(goal), goalCell))
+            return PATH_NOT_FOUND;
+        prepare(scratch);
+        scratch.start = start;
+        scratch.goal = goal;
+        scratch.startCell = startCell;
+        scratch.goalCell = goalCell;
+
+        scratch.cellPath.clear();
+        scratch.cellPath.push_back(startCell);
+        uint32_t startCluster = clusterOfCell(startCell), goalCluster = clusterOfCell(goalCell);
+        // close by: a plain search inside the shared cluster usually does it
+        if (startCluster == goalCluster && searchCluster(startCluster, startCell, goalCell, scratch))
+        {
+            appendClusterPath(startCluster, startCell, goalCell, scratch);
+            scratch.stage = PathScratch::SEARCH_STRAIGHTEN;
+            scratch.step = 0;
+        }
+        else
+        {
+            beginAbstract(startCell, goalCell, scratch);
+            scratch.stage = PathScratch::SEARCH_ABSTRACT;
+        }
+        return ContinuePath(scratch, waypoints, deadline);
+    }
+
+    PathStatus ContinuePath(PathScratch& scratch, std::vector<glm::vec3>& waypoints, std::chrono::steady_clock::time_point deadline) const
+    {
+        if (scratch.stage == PathScratch::SEARCH_ABSTRACT)
+        {
+            PathStatus status = continueAbstract(scratch, deadline);
+            if (status != PATH_FOUND)
+            {
+                if (status == PATH_NOT_FOUND)
+                    scratch.stage = PathScratch::SEARCH_IDLE;
+                return status;
+            }
+            scratch.stage = PathScratch::SEARCH_REFINE;
+            scratch.step = 0;
+            scratch.cell = scratch.startCell;
+        }
+
+        if (scratch.stage == PathScratch::SEARCH_REFINE)
+        {
+            // refine: cell searches inside each cluster the abstract path crosses
+            while (scratch.step < scratch.nodePath.size())
+            {
+                uint32_t node = scratch.nodePath[scratch.step++];
+                uint32_t next = m_Nodes[node].cell;
+                uint32_t cluster = clusterOfCell(scratch.cell);
+                if (cluster == m_Nodes[node].cluster)
+                {
+                    if (next != scratch.cell)
+                    {
+                        searchCluster(cluster, scratch.cell, next, scratch);
+                        appendClusterPath(cluster, scratch.cell, next, scratch);
+                    }
+                }
+                else
+                {
+                    scratch.cellPath.push_back(next);   // across a border
+                }
+                scratch.cell = next;
+                if (std::chrono::steady_clock::now() >= deadline)
+                    return PATH_PENDING;
+            }
+            if (scratch.cell != scratch.goalCell)
+            {
+                uint32_t goalCluster = clusterOfCell(scratch.goalCell);
+                searchCluster(goalCluster, scratch.cell, scratch.goalCell, scratch);
+                appendClusterPath(goalCluster, scratch.cell, scratch.goalCell, scratch);
+                scratch.cell = scratch.goalCell;
+            }
+            scratch.stage = PathScratch::SEARCH_STRAIGHTEN;
+            scratch.step = 0;
+        }
+
+        if (scratch.stage != PathScratch::SEARCH_STRAIGHTEN)
+            return PATH_NOT_FOUND;
+
+        // string pulling: from each kept point, skip ahead while the next cell is in straight view.
+        // The lookahead is bounded so each step costs at most a couple of clusters of line walking.
+        const size_t last = scratch.cellPath.size() - 1;
+        const bool exactStart = m_Grid.CellAt(scratch.start) == cellCoordinates(scratch.startCell);
+        const bool exactGoal = m_Grid.CellAt(scratch.goal) == cellCoordinates(scratch.goalCell);
+        auto point = [&](size_t i) {
+            if (i == 0 && exactStart)
+                return glm::vec2((scratch.start.x - m_Grid.Origin.x) / m_Grid.CellSize, (scratch.start.z - m_Grid.Origin.y) / m_Grid.CellSize);
+            if (i == last && exactGoal)
+                return glm::vec2((scratch.goal.x - m_Grid.Origin.x) / m_Grid.CellSize, (scratch.goal.z - m_Grid.Origin.y) / m_Grid.CellSize);
+            return glm::vec2(cellCoordinates(scratch.cellPath[i])) + 0.5f;
+        };
+        const size_t lookahead = static_cast<size_t>(m_ClusterSize) * 2;
+        while (scratch.step < last)
+        {
+            size_t anchor = scratch.step;
+            glm::vec2 from = point(anchor);
+            size_t next = anchor + 1;
+            while (next < last && next - anchor < lookahead && clearLine(from, point(next + 1)))
+                next++;
+            if (next < last)
+                waypoints.push_back(cellCenter(scratch.cellPath[next]));
+            scratch.step = next;
+            if (scratch.step < last && std::chrono::steady_clock::now() >= deadline)
+                return PATH_PENDING;
+        }
+        waypoints.push_back(exactGoal ? glm::vec3(scratch.goal.x, m_Grid.GroundY, scratch.goal.z) : cellCenter(scratch.goalCell));
+        scratch.stage = PathScratch::SEARCH_IDLE;
+        return PATH_FOUND;
+    }
+
+    size_t MemoryBytes() const { return m_Stats.graphBytes; }
+
+private:
+    struct Node {
+        uint32_t cell;
+        uint32_t cluster;
+    };
+
+    struct Edge {
+        uint32_t target;
+        float cost;
+    };
+
+    const NavigationGrid& m_Grid;
+    int m_ClusterSize;
+    int m_MaxEntranceWidth;
+    int m_ClustersX = 0;
+    int m_ClustersZ = 0;
+    std::vector<Node> m_Nodes;
+    std::vector<uint32_t> m_EdgeStart;
+    std::vector<Edge> m_Edges;
+    std::vector<uint32_t> m_ClusterNodeStart;
+    std::vector<uint32_t> m_ClusterNodes;
+    NavigationStats m_Stats;
+
+    static float octile(int dx, int dz)
+    {
+        dx = std::abs(dx);
+        dz = std::abs(dz);
+        return static_cast<float>(dx + dz) + (1.41421356f - 2.0f) * std::min(dx, dz);
+    }
+
+    int clusterOf(int x, int z) const { return (z / m_ClusterSize) * m_ClustersX + x / m_ClusterSize; }
+    uint32_t clusterOfCell(uint32_t cell) const { return static_cast<uint32_t>(clusterOf(cell % m_Grid.Width, cell / m_Grid.Width)); }
+    glm::ivec2 cellCoordinates(uint32_t cell) const { return glm::ivec2(cell % m_Grid.Width, cell / m_Grid.Width); }
+    glm::vec3 cellCenter(uint32_t cell) const { return m_Grid.CellCenter(cell % m_Grid.Width, cell / m_Grid.Width); }
+
+    // calls place(position) for one or two transitions per open stretch of a border
+    template <typename Open, typename Place>
+    void scanBorder(int begin, int end, Open open, Place place) const
+    {
+        int i = begin;
+        while (i < end)
+        {
+            if (!open(i))
+            {
+                i++;
+                continue;
+            }
+            int first = i;
+            while (i < end && open(i))
+                i++;
+            int last = i - 1;
+            if (last - first + 1 > m_MaxEntranceWidth)
+            {
+                place(first);
+                place(last);
+            }
+            else
+            {
+                place((first + last) / 2);
+            }
+        }
+    }
+
+    void prepare(PathScratch& scratch) const
+    {
+        if (scratch.nodeCost.size() != m_Nodes.size())
+        {
+            scratch.nodeCost.assign(m_Nodes.size(), 0.0f);
+            scratch.nodeParent.assign(m_Nodes.size(), 0);
+            scratch.nodeStamp.assign(m_Nodes.size(), 0);
+            scratch.goalCost.assign(m_Nodes.size(), 0.0f);
+            scratch.goalStamp.assign(m_Nodes.size(), 0);
+            scratch.nodeGeneration = 0;
+        }
+    }
+
+    bool nearestWalkable(const glm::ivec2& cell, uint32_t& result) const
+    {
+        for (int radius = 0; radius <= 4; radius++)
+            for (int dz = -radius; dz <= radius; dz++)
+                for (int dx = -radius; dx <= radius; dx++)
+                {
+                    if (std::max(std::abs(dx), std::abs(dz)) != radius || !m_Grid.IsWalkable(cell.x + dx, cell.y + dz))
+                        continue;
+                    result = static_cast<uint32_t>((cell.y + dz) * m_Grid.Width + cell.x + dx);
+                    return true;
+                }
+        return false;
+    }
+
+    // A* from start to goal, or Dijkstra to every cell when goal is UINT32_MAX, never leaving the cluster
+    bool searchCluster(uint32_t cluster, uint32_t start, uint32_t goal, PathScratch& scratch) const
+    {
+        size_t cells = static_cast<size_t>(m_ClusterSize) * m_ClusterSize;
+        if (scratch.cellCost.size() != cells)
+        {
+            scratch.cellCost.assign(cells, 0.0f);
+            scratch.cellParent.assign(cells, 0);
+            scratch.cellStamp.assign(cells, 0);
+            scratch.cellGeneration = 0;
+        }
+        if (++scratch.cellGeneration == 0)
+        {
+            std::fill(scratch.cellStamp.begin(), scratch.cellStamp.end(), 0);
+            scratch.cellGeneration = 1;
+        }
+        const int x0 = (cluster % m_ClustersX) * m_ClusterSize, z0 = (cluster / m_ClustersX) * m_ClusterSize;
+        const int x1 = std::min(m_Grid.Width, x0 + m_ClusterSize), z1 = std::min(m_Grid.Height, z0 + m_ClusterSize);
+        const int goalX = goal == UINT32_MAX ? 0 : static_cast<int>(goal % m_Grid.Width);
+        const int goalZ = goal == UINT32_MAX ? 0 : static_cast<int>(goal / m_Grid.Width);
+        auto heuristic = [&](int x, int z) { return goal == UINT32_MAX ? 0.0f : octile(x - goalX, z - goalZ); };
+        auto local = [&](int x, int z) { return static_cast<uint32_t>((z - z0) * m_ClusterSize + (x - x0)); };
+
+        int startX = static_cast<int>(start % m_Grid.Width), startZ = static_cast<int>(start / m_Grid.Width);
+        uint32_t startLocal = local(startX, startZ);
+        scratch.cellCost[startLocal] = 0.0f;
+        scratch.cellParent[startLocal] = startLocal;
+        scratch.cellStamp[startLocal] = scratch.cellGeneration;
+        scratch.open.clear();
+        scratch.open.push_back(PathScratch::OpenEntry{ heuristic(startX, startZ), 0.0f, startLocal });
+
+        while (!scratch.open.empty())
+        {
+            std::pop_heap(scratch.open.begin(), scratch.open.end(), std::greater<PathScratch::OpenEntry>());
+            PathScratch::OpenEntry entry = scratch.open.back();
+            scratch.open.pop_back();
+            if (entry.g > scratch.cellCost[entry.index])
+                continue;
+            int x = x0 + static_cast<int>(entry.index % m_ClusterSize), z = z0 + static_cast<int>(entry.index / m_ClusterSize);
+            scratch.expanded++;
+            if (goal != UINT32_MAX && x == goalX && z == goalZ)
+                return true;
+
+            for (int dz = -1; dz <= 1; dz++)
+                for (int dx = -1; dx <= 1; dx++)
+                {
+                    int nx = x + dx, nz = z + dz;
+                    if ((dx == 0 && dz == 0) || nx < x0 || nz < z0 || nx >= x1 || nz >= z1 || !m_Grid.IsWalkable(nx, nz))
+                        continue;
+                    // no cutting corners past an obstacle
+                    if (dx != 0 && dz != 0 && (!m_Grid.IsWalkable(x + dx, z) || !m_Grid.IsWalkable(x, z + dz)))
+                        continue;
+                    float cost = entry.g + (dx != 0 && dz != 0 ? 1.41421356f : 1.0f);
+                    uint32_t next = local(nx, nz);
+                    if (scratch.cellStamp[next] == scratch.cellGeneration && cost >= scratch.cellCost[next])
+                        continue;
+                    scratch.cellStamp[next] = scratch.cellGeneration;
+                    scratch.cellCost[next] = cost;
+                    scratch.cellParent[next] = entry.index;
+                    scratch.open.push_back(PathScratch::OpenEntry{ cost + heuristic(nx, nz), cost, next });
+                    std::push_heap(scratch.open.begin(), scratch.open.end(), std::greater<PathScratch::OpenEntry>());
+                }
+        }
+        return goal == UINT32_MAX;
+    }
+
+    // cost to cell from the last searchCluster in this cluster, FLT_MAX if it wasn't reached
+    float reachedCost(uint32_t cluster, uint32_t cell, const PathScratch& scratch) const
+    {
+        int x0 = (cluster % m_ClustersX) * m_ClusterSize, z0 = (cluster / m_ClustersX) * m_ClusterSize;
+        uint32_t index = static_cast<uint32_t>((static_cast<int>(cell / m_Grid.Width) - z0) * m_ClusterSize + (static_cast<int>(cell % m_Grid.Width) - x0));
+        return scratch.cellStamp[index] == scratch.cellGeneration ? scratch.cellCost[index] : FLT_MAX;
+    }
+
+    // appends the cells after from up to and including to, from the last searchCluster
+    void appendClusterPath(uint32_t cluster, uint32_t from, uint32_t to, PathScratch& scratch) const
+    {
+        int x0 = (cluster % m_ClustersX) * m_ClusterSize, z0 = (cluster / m_ClustersX) * m_ClusterSize;
+        auto local = [&](uint32_t cell) {
+            return static_cast<uint32_t>((static_cast<int>(cell / m_Grid.Width) - z0) * m_ClusterSize + (static_cast<int>(cell % m_Grid.Width) - x0));
+        };
+        uint32_t start = local(from);
+        scratch.segment.clear();
+        for (uint32_t index = local(to); index != start; index = scratch.cellParent[index])
+            scratch.segment.push_back(static_cast<uint32_t>((z0 + index / m_ClusterSize) * m_Grid.Width + x0 + index % m_ClusterSize));
+        scratch.cellPath.insert(scratch.cellPath.end(), scratch.segment.rbegin(), scratch.segment.rend());
+    }
+
+    // A* over the graph with start and goal joined to the nodes of their clusters; continueAbstract
+    // runs it and fills nodePath
+    void beginAbstract(uint32_t startCell, uint32_t goalCell, PathScratch& scratch) const
+    {
+        if (++scratch.nodeGeneration == 0)
+        {
+            std::fill(scratch.nodeStamp.begin(), scratch.nodeStamp.end(), 0);
+            std::fill(scratch.goalStamp.begin(), scratch.goalStamp.end(), 0);
+            scratch.nodeGeneration = 1;
+        }
+        const uint32_t generation = scratch.nodeGeneration;
+
+        // the way from each node of the goal's cluster to the goal (searched from the goal; moves are symmetric)
+        uint32_t goalCluster = clusterOfCell(goalCell);
+        searchCluster(goalCluster, goalCell, UINT32_MAX, scratch);
+        for (uint32_t i = m_ClusterNodeStart[goalCluster]; i < m_ClusterNodeStart[goalCluster + 1]; i++)
+        {
+            uint32_t node = m_ClusterNodes[i];
+            scratch.goalCost[node] = reachedCost(goalCluster, m_Nodes[node].cell, scratch);
+            scratch.goalStamp[node] = generation;
+        }
+
+        // and from the start to each node of its own cluster, which seeds the open list
+        uint32_t startCluster = clusterOfCell(startCell);
+        searchCluster(startCluster, startCell, UINT32_MAX, scratch);
+        scratch.open.clear();
+        for (uint32_t i = m_ClusterNodeStart[startCluster]; i < m_ClusterNodeStart[startCluster + 1]; i++)
+        {
+            uint32_t node = m_ClusterNodes[i];
+            float cost = reachedCost(startCluster, m_Nodes[node].cell, scratch);
+            if (cost == FLT_MAX)
+                continue;
+            scratch.nodeCost[node] = cost;
+            scratch.nodeParent[node] = UINT32_MAX;
+            scratch.nodeStamp[node] = generation;
+            scratch.open.push_back(PathScratch::OpenEntry{ cost + abstractHeuristic(node, goalCell), cost, node });
+        }
+        std::make_heap(scratch.open.begin(), scratch.open.end(), std::greater<PathScratch::OpenEntry>());
+        scratch.bestGoal = FLT_MAX;
+        scratch.bestLast = UINT32_MAX;
+    }
+
+    PathStatus continueAbstract(PathScratch& scratch, std::chrono::steady_clock::time_point deadline) const
+    {
+        const uint32_t generation = scratch.nodeGeneration;
+        const uint32_t goalNode = static_cast<uint32_t>(m_Nodes.size());    // virtual
+        unsigned int steps = 0;
+        while (!scratch.open.empty())
+        {
+            std::pop_heap(scratch.open.begin(), scratch.open.end(), std::greater<PathScratch::OpenEntry>());
+            PathScratch::OpenEntry entry = scratch.open.back();
+            scratch.open.pop_back();
+            if (entry.index == goalNode)
+                break;
+            if (entry.g > scratch.nodeCost[entry.index])
+                continue;
+            scratch.expanded++;
+
+            uint32_t node = entry.index;
+            if (scratch.goalStamp[node] == generation && scratch.goalCost[node] < FLT_MAX && entry.g + scratch.goalCost[node] < scratch.bestGoal)
+            {
+                scratch.bestGoal = entry.g + scratch.goalCost[node];
+                scratch.bestLast = node;
+                scratch.open.push_back(PathScratch::OpenEntry{ scratch.bestGoal, scratch.bestGoal, goalNode });
+                std::push_heap(scratch.open.begin(), scratch.open.end(), std::greater<PathScratch::OpenEntry>());
+            }
+            for (uint32_t e = m_EdgeStart[node]; e < m_EdgeStart[node + 1]; e++)
+            {
+                const Edge& edge = m_Edges[e];
+                float cost = entry.g + edge.cost;
+                if (scratch.nodeStamp[edge.target] == generation && cost >= scratch.nodeCost[edge.target])
+                    continue;
+                scratch.nodeStamp[edge.target] = generation;
+                scratch.nodeCost[edge.target] = cost;
+                scratch.nodeParent[edge.target] = node;
+                scratch.open.push_back(PathScratch::OpenEntry{ cost + abstractHeuristic(edge.target, scratch.goalCell), cost, edge.target });
+                std::push_heap(scratch.open.begin(), scratch.open.end(), std::greater<PathScratch::OpenEntry>());
+            }
+            if ((++steps & 63) == 0 && std::chrono::steady_clock::now() >= deadline)
+                return PATH_PENDING;
+        }
+        if (scratch.bestLast == UINT32_MAX)
+            return PATH_NOT_FOUND;
+
+        scratch.nodePath.clear();
+        for (uint32_t node = scratch.bestLast; node != UINT32_MAX; node = scratch.nodeParent[node])
+            scratch.nodePath.push_back(node);
+        std::reverse(scratch.nodePath.begin(), scratch.nodePath.end());
+        return PATH_FOUND;
+    }
+
+    float abstractHeuristic(uint32_t node, uint32_t goalCell) const
+    {
+        return octile(static_cast<int>(m_Nodes[node].cell % m_Grid.Width) - static_cast<int>(goalCell % m_Grid.Width),
+                      static_cast<int>(m_Nodes[node].cell / m_Grid.Width) - static_cast<int>(goalCell / m_Grid.Width));
+    }
+
+    // every cell the segment a..b (in cells) passes through must be walkable; passing exactly
+    // through a corner needs both cells beside it
+    bool clearLine(const glm::vec2& a, const glm::vec2& b) const
+    {
+        int x = static_cast<int>(std::floor(a.x)), z = static_cast<int>(std::floor(a.y));
+        int endX = static_cast<int>(std::floor(b.x)), endZ = static_cast<int>(std::floor(b.y));
+        glm::vec2 d = b - a;
+        int stepX = d.x > 0.0f ? 1 : -1, stepZ = d.y > 0.0f ? 1 : -1;
+        float deltaX = d.x != 0.0f ? std::fabs(1.0f / d.x) : FLT_MAX;
+        float deltaZ = d.y != 0.0f ? std::fabs(1.0f / d.y) : FLT_MAX;
+        float nextX = d.x != 0.0f ? (stepX > 0 ? x + 1 - a.x : a.x - x) * deltaX : FLT_MAX;
+        float nextZ = d.y != 0.0f ? (stepZ > 0 ? z + 1 - a.y : a.y - z) * deltaZ : FLT_MAX;
+        int remaining = std::abs(endX - x) + std::abs(endZ - z);
+        while (remaining > 0)
+        {
+            if (std::fabs(nextX - nextZ) < 1e-5f)
+            {
+                if (!m_Grid.IsWalkable(x + stepX, z) || !m_Grid.IsWalkable(x, z + stepZ))
+                    return false;
+                x += stepX;
+                z += stepZ;
+                nextX += deltaX;
+                nextZ += deltaZ;
+                remaining -= 2;
+            }
+            else if (nextX < nextZ)
+            {
+                x += stepX;
+                nextX += deltaX;
+                remaining--;
+            }
+            else
+            {
+                z += stepZ;
+                nextZ += deltaZ;
+                remaining--;
+            }
+            if (!m_Grid.IsWalkable(x, z))
+                return false;
+        }
+        return true;
+    }
+};
+
+struct PathQueueStats {
+    unsigned int processed = 0;     // last Update
+    unsigned int failed = 0;
+    unsigned int pending = 0;       // still queued after it
+    float updateMs = 0.0f;          // wall time of the last Update
+    unsigned long long totalProcessed = 0;
+};
+
+// Path requests from many agents, answered a batch per frame on the job system. Every worker
+// takes requests until the frame's time budget is spent; what is left waits for the next
+// frame, oldest first. A search still running when the budget runs out stops there and its
+// worker picks it up first next frame. Handles stay valid until Release.
+class PathRequestQueue
+{
+public:
+    PathRequestQueue(const HierarchicalPathfinder& pathfinder)
+        : m_Pathfinder(pathfinder)
+    {
+    }
+
+    unsigned int Request(const glm::vec3& start, const glm::vec3& goal)
+    {
+        unsigned int handle;
+        if (!m_Free.empty())
+        {
+            handle = m_Free.back();
+            m_Free.pop_back();
+        }
+        else
+        {
+            handle = static_cast<unsigned int>(m_Requests.size());
+            m_Requests.emplace_back();
+        }
+        Slot& request = m_Requests[handle];
+        request.start = start;
+        request.goal = goal;
+        request.status = PATH_PENDING;
+        request.waypoints.clear();
+        m_Pending.push_back(handle);
+        return handle;
+    }
+
+    PathStatus Status(unsigned int handle) const { return m_Requests[handle].status; }
+    const std::vector<glm::vec3>& Waypoints(unsigned int handle) const { return m_Requests[handle].waypoints; }
+    const PathQueueStats& Stats() const { return m_Stats; }
+
+    // the handle may be reused by a later Request; releasing a pending request cancels it
+    void Release(unsigned int handle)
+    {
+        if (m_Requests[handle].status == PATH_PENDING)
+            m_Requests[handle].released = true;     // freed once Update drops it from the queue
+        else
+            m_Free.push_back(handle);
+    }
+
+    void Update(JobSystem& jobs, float budgetMs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float, std::milli>(budgetMs));
+        unsigned int workers = jobs.ThreadCount() + 1;
+        if (m_Scratch.size() < workers)
+        {
+            m_Scratch.resize(workers);
+            m_Running.resize(workers, static_cast<unsigned int>(NO_REQUEST));
+        }
+        for (unsigned int& handle : m_Running)
+            if (handle != NO_REQUEST && m_Requests[handle].released)
+            {
+                drop(handle);
+                handle = NO_REQUEST;
+            }
+        m_Batch.clear();
+        for (unsigned int handle : m_Pending)
+        {
+            if (m_Requests[handle].released)
+                drop(handle);
+            else
+                m_Batch.push_back(handle);
+        }
+        m_Pending.clear();
+
+        std::atomic<unsigned int> next(0);
+        std::atomic<unsigned int> processed(0);
+        std::atomic<unsigned int> failed(0);
+        const unsigned int count = static_cast<unsigned int>(m_Batch.size());
+        jobs.ParallelFor(static_cast<unsigned int>(m_Scratch.size()), [&](unsigned int worker) {
+            unsigned int handle = m_Running[worker];
+            m_Running[worker] = NO_REQUEST;
+            bool resume = handle != NO_REQUEST;
+            for (;;)
+            {
+                if (!resume)
+                {
+                    if (std::chrono::steady_clock::now() >= deadline)
+                        return;
+                    handle = next++;
+                    if (handle >= count)
+                        return;
+                    handle = m_Batch[handle];
+                }
+                Slot& request = m_Requests[handle];
+                PathStatus status = resume ? m_Pathfinder.ContinuePath(m_Scratch[worker], request.waypoints, deadline)
+                                           : m_Pathfinder.StartPath(request.start, request.goal, m_Scratch[worker], request.waypoints, deadline);
+                resume = false;
+                if (status == PATH_PENDING)
+                {
+                    m_Running[worker] = handle;
+                    return;
+                }
+                request.status = status;
+                processed++;
+                if (status == PATH_NOT_FOUND)
+                    failed++;
+            }
+        });
+
+        for (unsigned int i = std::min(next.load(), count); i < count; i++)
+            m_Pending.push_back(m_Batch[i]);
+        unsigned int running = 0;
+        for (unsigned int handle : m_Running)
+            running += handle != NO_REQUEST ? 1 : 0;
+
+        m_Stats.processed = processed;
+        m_Stats.failed = failed;
+        m_Stats.pending = static_cast<unsigned int>(m_Pending.size()) + running;
+        m_Stats.totalProcessed += processed;
+        m_Stats.updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    struct Slot {
+        glm::vec3 start;
+        glm::vec3 goal;
+        PathStatus status = PATH_PENDING;
+        bool released = false;
+        std::vector<glm::vec3> waypoints;
+    };
+
+    static const unsigned int NO_REQUEST = UINT32_MAX;
+
+    // a released request leaves the queue here
+    void drop(unsigned int handle)
+    {
+        Slot& request = m_Requests[handle];
+        request.released = false;
+        request.status = PATH_NOT_FOUND;
+        m_Free.push_back(handle);
+    }
+
+    const HierarchicalPathfinder& m_Pathfinder;
+    std::vector<Slot> m_Requests;
+    std::vector<unsigned int> m_Free;
+    std::vector<unsigned int> m_Pending;
+    std::vector<unsigned int> m_Batch;
+    std::vector<PathScratch> m_Scratch;
+    std::vector<unsigned int> m_Running;    // per worker, the search it stopped at the last deadline
+    PathQueueStats m_Stats;
+};
+
+#endif
@@ -0,0 +1,330 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include <glm/glm.hpp>
+
+#include "collision.h"
+#include "job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_CULLING_SSE2 1
+#endif
+
+struct OcclusionStats {
+    unsigned int occluderTriangles = 0;
+    unsigned int tested = 0;
+    unsigned int frustumCulled = 0;
+    unsigned int occluded = 0;
+    float rasterizeMs = 0.0f;
+    float testMs = 0.0f;
+
+    float CulledPercent() const { return tested ? 100.0f * (frustumCulled + occluded) / tested : 0.0f; }
+};
+
+// Software occlusion culling. Occluders (a handful of big, simplified meshes) are rasterized into
+// a small CPU depth buffer, four pixels at a time, in horizontal bands spread over the job system.
+// Object bounds are then projected and compared against that buffer: a box whose nearest point is
+// behind every covered depth sample can't be seen. Everything runs on the CPU, so the pass works
+// (and can be measured) without a GL context.
+class OcclusionCuller
+{
+public:
+    static const int BAND_HEIGHT = 16;
+
+    // width is rounded up to a multiple of 4 so rows can be processed in SIMD quads
+    OcclusionCuller(int width = 256, int height = 128)
+        : m_Width((width + 3) & ~3), m_Height(height), m_Depth(m_Width * height, 1.0f)
+    {
+    }
+
+    int Width() const { return m_Width; }
+    int Height() const { return m_Height; }
+    const std::vector<float>& DepthBuffer() const { return m_Depth; }
+    const OcclusionStats& Stats() const { return m_Stats; }
+
+    void BeginFrame(const glm::mat4& viewProjection)
+    {
+        m_ViewProjection = viewProjection;
+        m_Triangles.clear();
+        m_Stats = OcclusionStats();
+    }
+
+    // indexed triangle list in model space; pass simplified geometry, every triangle costs raster time
+    void AddOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, const glm::mat4& model)
+    {
+        glm::mat4 modelViewProjection = m_ViewProjection * model;
+        m_Clip.resize(positions.size());
+        for (size_t i = 0; i < positions.size(); i++)
+            m_Clip[i] = modelViewProjection * glm::vec4(positions[i], 1.0f);
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            addClipTriangle(m_Clip[indices[i]], m_Clip[indices[i + 1]], m_Clip[indices[i + 2]]);
+    }
+
+    // solid world-space box, e.g. a pillar's collider
+    void AddOccluderBox(const AABB& box)
+    {
+        static const unsigned int boxIndices[36] = {
+            0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   0, 1, 4, 1, 5, 4,
+            2, 6, 3, 3, 6, 7,   0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5
+        };
+        glm::vec4 corners[8];
+        for (int i = 0; i < 8; i++)
+            corners[i] = m_ViewProjection * glm::vec4(boxCorner(box, i), 1.0f);
+        for (int i = 0; i < 36; i += 3)
+            addClipTriangle(corners[boxIndices[i]], corners[boxIndices[i + 1]], corners[boxIndices[i + 2]]);
+    }
+
+    // clears the depth buffer and rasterizes every occluder added since BeginFrame
+    void Rasterize(JobSystem& jobs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        m_Stats.occluderTriangles = static_cast<unsigned int>(m_Triangles.size());
+        unsigned int bands = static_cast<unsigned int>((m_Height + BAND_HEIGHT - 1) / BAND_HEIGHT);
+        jobs.ParallelFor(bands, [this](unsigned int band) {
+            int y0 = band * BAND_HEIGHT;
+            int y1 = std::min(y0 + BAND_HEIGHT, m_Height);
+            std::fill(m_Depth.begin() + y0 * m_Width, m_Depth.begin() + y1 * m_Width, 1.0f);
+            for (const ScreenTriangle& triangle : m_Triangles)
+                if (triangle.maxY >= y0 && triangle.minY < y1)
+                    rasterizeTriangle(triangle, std::max(triangle.minY, y0), std::min(triangle.maxY, y1 - 1));
+        });
+        m_Stats.rasterizeMs = elapsedMs(start);
+    }
+
+    // visible[i] is set to 1 when boxes[i] may be visible, 0 when it is outside the frustum or hidden
+    void TestBoxes(const std::vector<AABB>& boxes, std::vector<uint8_t>& visible, JobSystem& jobs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        const unsigned int batchSize = 64;
+        visible.resize(boxes.size());
+        std::vector<uint8_t> result(boxes.size());
+        unsigned int batches = static_cast<unsigned int>((boxes.size() + batchSize - 1) / batchSize);
+        jobs.ParallelFor(batches, [&](unsigned int batch) {
+            size_t end = std::min<size_t>(boxes.size(), (batch + 1) * batchSize);
+            for (size_t i = batch * batchSize; i < end; i++)
+                result[i] = static_cast<uint8_t>(testBox(boxes[i]));
+        });
+
+        m_Stats.tested += static_cast<unsigned int>(boxes.size());
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            visible[i] = result[i] == VISIBLE;
+            if (result[i] == OUTSIDE_FRUSTUM)
+                m_Stats.frustumCulled++;
+            else if (result[i] == OCCLUDED)
+                m_Stats.occluded++;
+        }
+        m_Stats.testMs = elapsedMs(start);
+    }
+
+private:
+    enum TestResult : uint8_t { OUTSIDE_FRUSTUM = 0, OCCLUDED = 1, VISIBLE = 2 };
+
+    // edge functions and depth plane, evaluated at pixel centres: value = a * x + b * y + c
+    struct ScreenTriangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, maxX, minY, maxY;
+    };
+
+    int m_Width;
+    int m_Height;
+    std::vector<float> m_Depth;     // NDC depth remapped to [0, 1], row 0 at the bottom
+    glm::mat4 m_ViewProjection;
+    std::vector<ScreenTriangle> m_Triangles;
+    std::vector<glm::vec4> m_Clip;
+    OcclusionStats m_Stats;
+
+    static float elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static glm::vec3 boxCorner(const AABB& box, int i)
+    {
+        return glm::vec3(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+    }
+
+    glm::vec3 toScreen(const glm::vec4& clip) const
+    {
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * m_Width, (ndc.y * 0.5f + 0.5f) * m_Height, ndc.z * 0.5f + 0.5f);
+    }
+
+    // clips against the near plane (z = -w) and fans the remaining polygon into screen triangles
+    void addClipTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+    {
+        const glm::vec4 input[3] = { a, b, c };
+        glm::vec4 polygon[4];
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4& p = input[i];
+            const glm::vec4& q = input[(i + 1) % 3];
+            float dp = p.z + p.w, dq = q.z + q.w;
+            if (dp >= 0.0f)
+                polygon[count++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f))
+                polygon[count++] = p + (q - p) * (dp / (dp - dq));
+        }
+        for (int i = 1; i + 1 < count; i++)
+            setupTriangle(toScreen(polygon[0]), toScreen(polygon[i]), toScreen(polygon[i + 1]));
+    }
+
+    void setupTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+        if (std::fabs(area) < 1e-6f)
+            return;
+        // occluders are solid, so both facings are drawn; make the winding counter-clockwise
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        ScreenTriangle triangle;
+        triangle.minX = std::max(0, static_cast<int>(std::floor(std::min(v0.x, std::min(v1.x, v2.x)))));
+        triangle.maxX = std::min(m_Width - 1, static_cast<int>(std::ceil(std::max(v0.x, std::max(v1.x, v2.x)))));
+        triangle.minY = std::max(0, static_cast<int>(std::floor(std::min(v0.y, std::min(v1.y, v2.y)))));
+        triangle.maxY = std::min(m_Height - 1, static_cast<int>(std::ceil(std::max(v0.y, std::max(v1.y, v2.y)))));
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        const glm::vec3* v[3] = { &v0, &v1, &v2 };
+        for (int e = 0; e < 3; e++)
+        {
+            const glm::vec3& p = *v[e];
+            const glm::vec3& q = *v[(e + 1) % 3];
+            triangle.edgeA[e] = p.y - q.y;
+            triangle.edgeB[e] = q.x - p.x;
+            triangle.edgeC[e] = p.x * q.y - p.y * q.x;
+        }
+        // edge e is opposite vertex (e + 2) % 3, so its normalized value is that vertex's barycentric weight
+        triangle.depthA = (triangle.edgeA[1] * v0.z + triangle.edgeA[2] * v1.z + triangle.edgeA[0] * v2.z) / area;
+        triangle.depthB = (triangle.edgeB[1] * v0.z + triangle.edgeB[2] * v1.z + triangle.edgeB[0] * v2.z) / area;
+        triangle.depthC = (triangle.edgeC[1] * v0.z + triangle.edgeC[2] * v1.z + triangle.edgeC[0] * v2.z) / area;
+        m_Triangles.push_back(triangle);
+    }
+
+    void rasterizeTriangle(const ScreenTriangle& t, int y0, int y1)
+    {
+        int x0 = t.minX & ~3;
+#ifdef OCCLUSION_CULLING_SSE2
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+        __m128 a[3], step[3];
+        for (int e = 0; e < 3; e++)
+        {
+            a[e] = _mm_set1_ps(t.edgeA[e]);
+            step[e] = _mm_set1_ps(t.edgeA[e] * 4.0f);
+        }
+        const __m128 depthA = _mm_set1_ps(t.depthA);
+        const __m128 depthStep = _mm_set1_ps(t.depthA * 4.0f);
+
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x0)), laneOffsets);
+            __m128 edge[3];
+            for (int e = 0; e < 3; e++)
+                edge[e] = _mm_add_ps(_mm_mul_ps(a[e], px), _mm_set1_ps(t.edgeB[e] * py + t.edgeC[e]));
+            __m128 depth = _mm_add_ps(_mm_mul_ps(depthA, px), _mm_set1_ps(t.depthB * py + t.depthC));
+
+            float* row = &m_Depth[y * m_Width];
+            for (int x = x0; x <= t.maxX; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(edge[0], zero), _mm_cmpge_ps(edge[1], zero)), _mm_cmpge_ps(edge[2], zero));
+                if (_mm_movemask_ps(inside))
+                {
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 closer = _mm_min_ps(old, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, closer), _mm_andnot_ps(inside, old)));
+                }
+                for (int e = 0; e < 3; e++)
+                    edge[e] = _mm_add_ps(edge[e], step[e]);
+                depth = _mm_add_ps(depth, depthStep);
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = y + 0.5f;
+            float* row = &m_Depth[y * m_Width];
+            for (int x = x0; x <= t.maxX; x++)
+            {
+                float px = x + 0.5f;
+                if (t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0] >= 0.0f &&
+                    t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1] >= 0.0f &&
+                    t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2] >= 0.0f)
+                    row[x] = std::min(row[x], t.depthA * px + t.depthB * py + t.depthC);
+            }
+        }
+#endif
+    }
+
+    TestResult testBox(const AABB& box) const
+    {
+        glm::vec4 clip[8];
+        int outside[6] = { 0, 0, 0, 0, 0, 0 };
+        bool crossesNear = false;
+        for (int i = 0; i < 8; i++)
+        {
+            clip[i] = m_ViewProjection * glm::vec4(boxCorner(box, i), 1.0f);
+            const glm::vec4& c = clip[i];
+            outside[0] += c.x < -c.w;
+            outside[1] += c.x > c.w;
+            outside[2] += c.y < -c.w;
+            outside[3] += c.y > c.w;
+            outside[4] += c.z < -c.w;
+            outside[5] += c.z > c.w;
+            crossesNear = crossesNear || c.z < -c.w;
+        }
+        for (int plane = 0; plane < 6; plane++)
+            if (outside[plane] == 8)
+                return OUTSIDE_FRUSTUM;
+        if (crossesNear)
+            return VISIBLE;
+
+        glm::vec3 minS(1e30f), maxS(-1e30f);
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 s = toScreen(clip[i]);
+            minS = glm::min(minS, s);
+            maxS = glm::max(maxS, s);
+        }
+        int x0 = std::max(0, static_cast<int>(std::floor(minS.x)));
+        int x1 = std::min(m_Width - 1, static_cast<int>(std::ceil(maxS.x)));
+        int y0 = std::max(0, static_cast<int>(std::floor(minS.y)));
+        int y1 = std::min(m_Height - 1, static_cast<int>(std::ceil(maxS.y)));
+        if (x0 > x1 || y0 > y1)
+            return OUTSIDE_FRUSTUM;
+
+        // visible as soon as one covered sample is at or behind the box's nearest point
+        float nearest = minS.z;
+        for (int y = y0; y <= y1; y++)
+        {
+            const float* row = &m_Depth[y * m_Width];
+            int x = x0;
+#ifdef OCCLUSION_CULLING_SSE2
+            const __m128 boxDepth = _mm_set1_ps(nearest);
+            for (; x + 3 <= x1; x += 4)
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)))
+                    return VISIBLE;
+#endif
+            for (; x <= x1; x++)
+                if (row[x] >= nearest)
+                    return VISIBLE;
+        }
+        return OCCLUDED;
+    }
+};
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef PACKED_MESH_H
+#define PACKED_MESH_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader_m.h>
+
+#include "vertex_packing.h"
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// GPU copy of a mesh in the packed vertex format (see vertex_packing.h). Attribute locations
+// match the shaders: 0 position, 1 octahedral normal, 2 texcoords, 5 bone ids, 6 weights.
+// Owns its VAO and buffers: it can be moved but not copied, and deletes them when destroyed,
+// so it has to go before the GL context does (or be released explicitly).
+class PackedMesh
+{
+public:
+    std::vector<Texture> textures;
+    PackedVertexLayout Layout;
+    unsigned int VAO = 0;
+    unsigned int IndexCount = 0;
+    GLenum IndexType = GL_UNSIGNED_INT;
+    size_t GpuBytes = 0;
+
+    // from learnopengl vertices; skinned keeps bone ids and weights
+    PackedMesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, const std::vector<Texture>& textures,
+               bool skinned, PackingStats* stats = nullptr)
+        : textures(textures)
+    {
+        std::vector<UnpackedVertex> source(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            source[i].position = vertices[i].Position;
+            source[i].normal = vertices[i].Normal;
+            source[i].texCoords = vertices[i].TexCoords;
+            for (int j = 0; j < 4; j++)
+            {
+                source[i].boneIds[j] = skinned ? vertices[i].m_BoneIDs[j] : -1;
+                source[i].weights[j] = skinned ? vertices[i].m_Weights[j] : 0.0f;
+            }
+        }
+
+        PackingStats meshStats;
+        upload(packGeometry(source, indices, skinned, &meshStats));
+        meshStats.sourceBytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+        if (stats)
+            stats->Add(meshStats);
+    }
+
+    // from a non-indexed position(3) / normal(3) / texcoord(2) float array like the plane and cube literals
+    PackedMesh(const float* interleaved, unsigned int vertexCount, PackingStats* stats = nullptr)
+    {
+        std::vector<UnpackedVertex> source(vertexCount);
+        std::vector<unsigned int> indices(vertexCount);
+        for (unsigned int i = 0; i < vertexCount; i++)
+        {
+            const float* v = interleaved + i * 8;
+            source[i].position = glm::vec3(v[0], v[1], v[2]);
+            source[i].normal = glm::vec3(v[3], v[4], v[5]);
+            source[i].texCoords = glm::vec2(v[6], v[7]);
+            for (int j = 0; j < 4; j++)
+            {
+                source[i].boneIds[j] = -1;
+                source[i].weights[j] = 0.0f;
+            }
+            indices[i] = i;
+        }
+
+        PackingStats meshStats;
+        upload(packGeometry(source, indices, false, &meshStats));
+        meshStats.sourceBytes = vertexCount * 8 * sizeof(float);
+        if (stats)
+            stats->Add(meshStats);
+    }
+
+    PackedMesh(const PackedMesh&) = delete;
+    PackedMesh& operator=(const PackedMesh&) = delete;
+
+    PackedMesh(PackedMesh&& other)
+    {
+        *this = std::move(other);
+    }
+
+    PackedMesh& operator=(PackedMesh&& other)
+    {
+        if (this != &other)
+        {
+            Release();
+            textures = std::move(other.textures);
+            Layout = other.Layout;
+            VAO = other.VAO;
+            VBO = other.VBO;
+            EBO = other.EBO;
+            IndexCount = other.IndexCount;
+            IndexType = other.IndexType;
+            GpuBytes = other.GpuBytes;
+            other.VAO = other.VBO = other.EBO = 0;
+            other.IndexCount = 0;
+            other.GpuBytes = 0;
+        }
+        return *this;
+    }
+
+    ~PackedMesh()
+    {
+        Release();
+    }
+
+    // deletes the GL objects now; safe to call more than once
+    void Release()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO)
+            glDeleteBuffers(1, &VBO);
+        if (EBO)
+            glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+        IndexCount = 0;
+        GpuBytes = 0;
+    }
+
+    // same texture binding convention as Mesh::Draw (texture_diffuseN, texture_specularN, ...)
+    void Draw(Shader& shader)
+    {
+        bindTextures(shader);
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, IndexCount, IndexType, 0);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // per-instance attributes have to be set up on VAO by the caller
+    void DrawInstanced(Shader& shader, unsigned int instanceCount)
+    {
+        bindTextures(shader);
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, IndexCount, IndexType, 0, instanceCount);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    unsigned int VBO = 0, EBO = 0;
+
+    void bindTextures(Shader& shader)
+    {
+        unsigned int diffuseNr = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr = 1;
+        unsigned int heightNr = 1;
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i);
+            std::string number;
+            std::string name = textures[i].type;
+            if (name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (name == "texture_specular")
+                number = std::to_string(specularNr++);
+            else if (name == "texture_normal")
+                number = std::to_string(normalNr++);
+            else if (name == "texture_height")
+                number = std::to_string(heightNr++);
+
+            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
+
+    void upload(const PackedGeometry& geometry)
+    {
+        Layout = geometry.layout;
+        IndexCount = geometry.indexCount;
+        IndexType = geometry.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        GpuBytes = geometry.vertices.size() + geometry.indices.size();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, geometry.vertices.size(), geometry.vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, geometry.indices.size(), geometry.indices.data(), GL_STATIC_DRAW);
+
+        // vertex positions
+        glEnableVertexAttribArray(0);
+        if (Layout.halfPositions)
+            glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, Layout.stride, (void*)0);
+        else
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Layout.stride, (void*)0);
+        // octahedral normal, decoded in the vertex shader
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, Layout.stride, (void*)(size_t)Layout.normalOffset);
+        // texture coords
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, Layout.stride, (void*)(size_t)Layout.texCoordOffset);
+        if (Layout.skinned)
+        {
+            // ids
+            glEnableVertexAttribArray(5);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, Layout.stride, (void*)(size_t)Layout.boneIdOffset);
+            // weights
+            glEnableVertexAttribArray(6);
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, Layout.stride, (void*)(size_t)Layout.weightOffset);
+        }
+        glBindVertexArray(0);
+    }
+};
+
+// one line per model: memory before/after and what the cache optimisation bought
+inline void reportPacking(const std::string& name, const PackingStats& stats)
+{
+    std::cout << "Packed " << name << ": " << stats.sourceBytes << " -> " << stats.packedBytes << " bytes ("
+              << stats.sourceVertices << " -> " << stats.packedVertices << " vertices), ACMR "
+              << stats.acmrBefore << " -> " << stats.acmrAfter << std::endl;
+}
+
+#endif
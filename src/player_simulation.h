@@ -0,0 +1,214 @@
+#ifndef PLAYER_SIMULATION_H
+#define PLAYER_SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include "collision.h"
+
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+// What a player asks for in one tick. The window turns keys and the mouse into this; a server
+// gets it from the network or, in tests and benchmarks, from a script.
+struct PlayerInput {
+    bool forward = false;
+    bool back = false;
+    bool left = false;
+    bool right = false;
+    bool jump = false;
+    float yaw = 0.0f;       // degrees, 0 faces -z
+};
+
+class PlayerInputSource
+{
+public:
+    virtual ~PlayerInputSource() {}
+    virtual PlayerInput Poll() = 0;
+};
+
+struct PlayerSettings {
+    float speed = 2.5f;
+    float gravity = -9.81f;
+    float jumpSpeed = 5.0f;
+    float halfSize = 0.5f;      // the player is a cube
+    float groundY = 0.0f;
+};
+
+struct PlayerState {
+    glm::vec3 position = glm::vec3(0.0f, 0.5f, 5.0f);
+    float velocityY = 0.0f;
+    bool onGround = true;
+};
+
+// One tick of the cube player: resolve vertical movement against the colliders, then x and z
+// separately so the player slides along walls, then jump, then fall onto the ground plane.
+// Indices of the colliders it touched are appended to touched when given.
+inline void stepPlayer(PlayerState& state, const PlayerInput& input, const PlayerSettings& settings,
+                       const std::vector<AABB>& colliders, float deltaTime, std::vector<unsigned int>* touched = nullptr)
+{
+    float velocity = settings.speed * deltaTime;
+    float yawRad = glm::radians(input.yaw);
+    glm::vec3 forward(-std::sin(yawRad), 0.0f, -std::cos(yawRad));
+    glm::vec3 right(std::cos(yawRad), 0.0f, -std::sin(yawRad));
+    const float halfSize = settings.halfSize;
+
+    glm::vec3 newPos = state.position;
+    state.velocityY += settings.gravity * deltaTime;
+    glm::vec3 tempPosY = newPos + glm::vec3(0.0f, state.velocityY * deltaTime, 0.0f);
+    AABB boxY{ tempPosY - glm::vec3(halfSize), tempPosY + glm::vec3(halfSize) };
+    for (unsigned int i = 0; i < colliders.size(); i++)
+    {
+        const AABB& box = colliders[i];
+        if (!checkCollisionAABB(boxY, box))
+            continue;
+        if (touched)
+            touched->push_back(i);
+        if (state.velocityY < 0.0f)
+        {
+            tempPosY.y = box.max.y + halfSize;
+            state.velocityY = 0.0f;
+            state.onGround = true;
+        }
+        else if (state.velocityY > 0.0f)
+        {
+            tempPosY.y = box.min.y - halfSize;
+            state.velocityY = 0.0f;
+        }
+    }
+    newPos.y = tempPosY.y;
+
+    glm::vec3 move(0.0f);
+    if (input.forward) move += forward * velocity;
+    if (input.back) move -= forward * velocity;
+    if (input.left) move -= right * velocity;
+    if (input.right) move += right * velocity;
+
+    // colliders the player stands on top of don't block sideways movement
+    auto blocked = [&](const glm::vec3& position) {
+        AABB box{ position - glm::vec3(halfSize), position + glm::vec3(halfSize) };
+        bool collision = false;
+        for (unsigned int i = 0; i < colliders.size(); i++)
+            if (checkCollisionAABB(box, colliders[i]) && tempPosY.y - halfSize < colliders[i].max.y - 0.01f)
+            {
+                if (touched)
+                    touched->push_back(i);
+                collision = true;
+            }
+        return collision;
+    };
+    if (!blocked(newPos + glm::vec3(move.x, 0.0f, 0.0f)))
+        newPos.x += move.x;
+    if (!blocked(newPos + glm::vec3(0.0f, 0.0f, move.z)))
+        newPos.z += move.z;
+
+    if (input.jump && state.onGround)
+    {
+        state.velocityY = settings.jumpSpeed;
+        state.onGround = false;
+    }
+    state.position = newPos;
+
+    state.velocityY += settings.gravity * deltaTime;
+    state.position.y += state.velocityY * deltaTime;
+    if (state.position.y <= settings.groundY + halfSize)
+    {
+        state.position.y = settings.groundY + halfSize;
+        state.velocityY = 0.0f;
+        state.onGround = true;
+    }
+    else
+    {
+        state.onGround = false;
+    }
+}
+
+// Turns variable frame times into a whole number of fixed ticks, so the simulation gives the
+// same result at any frame rate and on a server with no frame rate at all.
+class FixedTimestep
+{
+public:
+    float Step;
+
+    // maxSteps bounds the catch-up after a stall, so a long hitch doesn't snowball
+    FixedTimestep(float ticksPerSecond = 60.0f, unsigned int maxSteps = 8)
+        : Step(1.0f / ticksPerSecond), m_MaxSteps(maxSteps)
+    {
+    }
+
+    // ticks to run for this frame
+    unsigned int Advance(float deltaTime)
+    {
+        m_Accumulator += deltaTime;
+        unsigned int steps = static_cast<unsigned int>(m_Accumulator / Step);
+        m_Accumulator -= steps * Step;
+        if (steps > m_MaxSteps)
+            steps = m_MaxSteps;
+        return steps;
+    }
+
+    // how far between the last two ticks the frame is, for interpolating what is drawn
+    float Alpha() const { return m_Accumulator / Step; }
+
+private:
+    unsigned int m_MaxSteps;
+    float m_Accumulator = 0.0f;
+};
+
+// Static colliders bucketed into a uniform grid on x/z, so a player only tests the boxes around
+// it instead of the whole world. A box spanning several cells is listed in each of them.
+class CollisionGrid
+{
+public:
+    CollisionGrid(float cellSize = 20.0f)
+        : m_CellSize(cellSize)
+    {
+    }
+
+    unsigned int ColliderCount() const { return static_cast<unsigned int>(m_Boxes.size()); }
+
+    void Add(const AABB& box)
+    {
+        unsigned int index = static_cast<unsigned int>(m_Boxes.size());
+        m_Boxes.push_back(box);
+        glm::ivec2 first = cell(box.min), last = cell(box.max);
+        for (int z = first.y; z <= last.y; z++)
+            for (int x = first.x; x <= last.x; x++)
+                m_Cells[std::make_pair(x, z)].push_back(index);
+    }
+
+    // every collider overlapping region; out is replaced
+    void Gather(const AABB& region, std::vector<AABB>& out) const
+    {
+        out.clear();
+        glm::ivec2 first = cell(region.min), last = cell(region.max);
+        for (int z = first.y; z <= last.y; z++)
+            for (int x = first.x; x <= last.x; x++)
+            {
+                auto found = m_Cells.find(std::make_pair(x, z));
+                if (found == m_Cells.end())
+                    continue;
+                for (unsigned int index : found->second)
+                {
+                    const AABB& box = m_Boxes[index];
+                    // a box listed in several cells is reported only from the first of them inside the region
+                    glm::ivec2 home = glm::max(cell(box.min), first);
+                    if (home.x == x && home.y == z && checkCollisionAABB(region, box))
+                        out.push_back(box);
+                }
+            }
+    }
+
+private:
+    float m_CellSize;
+    std::vector<AABB> m_Boxes;
+    std::map<std::pair<int, int>, std::vector<unsigned int>> m_Cells;
+
+    glm::ivec2 cell(const glm::vec3& position) const
+    {
+        return glm::ivec2(static_cast<int>(std::floor(position.x / m_CellSize)), static_cast<int>(std::floor(position.z / m_CellSize)));
+    }
+};
+
+#endif
@@ -0,0 +1,354 @@
+#ifndef POSE_BLEND_H
+#define POSE_BLEND_H
+
+#include <glm/glm.hpp>
+
+#include "skeleton.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POSE_BLEND_SSE2 1
+#endif
+
+// out = a blended towards b by weight: lerp for translation and scale, nlerp for rotation.
+// nlerp takes the shorter arc like slerp but is only multiplies and one reciprocal square root,
+// close enough for the small angles between keyframes and between clips in a crossfade.
+// out may be a or b. With jointLimit only the first joints are blended, rounded up to a
+// multiple of four; the rest of out is left as it was.
+inline void blendPoses(const PoseBuffer& a, const PoseBuffer& b, float weight, PoseBuffer& out, unsigned int jointLimit = ~0u)
+{
+    if (out.Stride != a.Stride)
+        out.Resize(a.JointCount);
+    const unsigned int stride = (std::min(jointLimit, a.JointCount) + 3) & ~3u;
+    const int linear[] = { PoseBuffer::TX, PoseBuffer::TY, PoseBuffer::TZ, PoseBuffer::SX, PoseBuffer::SY, PoseBuffer::SZ };
+    const float* ax = a.Channel(PoseBuffer::RX);
+    const float* ay = a.Channel(PoseBuffer::RY);
+    const float* az = a.Channel(PoseBuffer::RZ);
+    const float* aw = a.Channel(PoseBuffer::RW);
+    const float* bx = b.Channel(PoseBuffer::RX);
+    const float* by = b.Channel(PoseBuffer::RY);
+    const float* bz = b.Channel(PoseBuffer::RZ);
+    const float* bw = b.Channel(PoseBuffer::RW);
+    float* ox = out.Channel(PoseBuffer::RX);
+    float* oy = out.Channel(PoseBuffer::RY);
+    float* oz = out.Channel(PoseBuffer::RZ);
+    float* ow = out.Channel(PoseBuffer::RW);
+
+#ifdef POSE_BLEND_SSE2
+    const __m128 w = _mm_set1_ps(weight);
+    for (int channel : linear)
+    {
+        const float* pa = a.Channel(channel);
+        const float* pb = b.Channel(channel);
+        float* po = out.Channel(channel);
+        for (unsigned int i = 0; i < stride; i += 4)
+        {
+            __m128 va = _mm_loadu_ps(pa + i);
+            _mm_storeu_ps(po + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(pb + i), va), w)));
+        }
+    }
+
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 threeHalves = _mm_set1_ps(1.5f);
+    for (unsigned int i = 0; i < stride; i += 4)
+    {
+        __m128 x0 = _mm_loadu_ps(ax + i), y0 = _mm_loadu_ps(ay + i), z0 = _mm_loadu_ps(az + i), w0 = _mm_loadu_ps(aw + i);
+        __m128 x1 = _mm_loadu_ps(bx + i), y1 = _mm_loadu_ps(by + i), z1 = _mm_loadu_ps(bz + i), w1 = _mm_loadu_ps(bw + i);
+        // q and -q are the same rotation; flip b into a's hemisphere so the blend takes the short way
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x0, x1), _mm_mul_ps(y0, y1)), _mm_add_ps(_mm_mul_ps(z0, z1), _mm_mul_ps(w0, w1)));
+        __m128 flip = _mm_and_ps(dot, signBit);
+        x1 = _mm_xor_ps(x1, flip);
+        y1 = _mm_xor_ps(y1, flip);
+        z1 = _mm_xor_ps(z1, flip);
+        w1 = _mm_xor_ps(w1, flip);
+
+        __m128 x = _mm_add_ps(x0, _mm_mul_ps(_mm_sub_ps(x1, x0), w));
+        __m128 y = _mm_add_ps(y0, _mm_mul_ps(_mm_sub_ps(y1, y0), w));
+        __m128 z = _mm_add_ps(z0, _mm_mul_ps(_mm_sub_ps(z1, z0), w));
+        __m128 qw = _mm_add_ps(w0, _mm_mul_ps(_mm_sub_ps(w1, w0), w));
+
+        // rsqrt estimate refined by one Newton step, good to about 1e-7
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(qw, qw)));
+        __m128 inverse = _mm_rsqrt_ps(length2);
+        inverse = _mm_mul_ps(inverse, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, length2), _mm_mul_ps(inverse, inverse))));
+        _mm_storeu_ps(ox + i, _mm_mul_ps(x, inverse));
+        _mm_storeu_ps(oy + i, _mm_mul_ps(y, inverse));
+        _mm_storeu_ps(oz + i, _mm_mul_ps(z, inverse));
+        _mm_storeu_ps(ow + i, _mm_mul_ps(qw, inverse));
+    }
+#else
+    for (int channel : linear)
+    {
+        const float* pa = a.Channel(channel);
+        const float* pb = b.Channel(channel);
+        float* po = out.Channel(channel);
+        for (unsigned int i = 0; i < stride; i++)
+            po[i] = pa[i] + (pb[i] - pa[i]) * weight;
+    }
+
+    for (unsigned int i = 0; i < stride; i++)
+    {
+        float sign = ax[i] * bx[i] + ay[i] * by[i] + az[i] * bz[i] + aw[i] * bw[i] < 0.0f ? -1.0f : 1.0f;
+        float x = ax[i] + (bx[i] * sign - ax[i]) * weight;
+        float y = ay[i] + (by[i] * sign - ay[i]) * weight;
+        float z = az[i] + (bz[i] * sign - az[i]) * weight;
+        float w = aw[i] + (bw[i] * sign - aw[i]) * weight;
+        float inverse = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+        ox[i] = x * inverse;
+        oy[i] = y * inverse;
+        oz[i] = z * inverse;
+        ow[i] = w * inverse;
+    }
+#endif
+}
+
+// the clip's local pose at time (seconds, wrapped); jointLimit as for blendPoses
+inline void samplePose(const SkeletonClip& clip, float time, PoseBuffer& out, unsigned int jointLimit = ~0u)
+{
+    unsigned int frame0, frame1;
+    float blend;
+    clip.FramesAt(time, frame0, frame1, blend);
+    blendPoses(clip.Frame(frame0), clip.Frame(frame1), blend, out, jointLimit);
+}
+
+inline void multiplyMatrices(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+#ifdef POSE_BLEND_SSE2
+    __m128 a0 = _mm_loadu_ps(&a[0][0]), a1 = _mm_loadu_ps(&a[1][0]), a2 = _mm_loadu_ps(&a[2][0]), a3 = _mm_loadu_ps(&a[3][0]);
+    for (int column = 0; column < 4; column++)
+    {
+        __m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[column][0])), _mm_mul_ps(a1, _mm_set1_ps(b[column][1]))),
+                                   _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[column][2])), _mm_mul_ps(a3, _mm_set1_ps(b[column][3]))));
+        _mm_storeu_ps(&out[column][0], result);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+// Local SoA pose to final skinning matrices. The first pass turns four joints at a time from
+// TRS into matrices, written into globals; the second walks the flattened hierarchy once,
+// turning each into model space in place (parents come first, so theirs are already done).
+// With jointLimit only the first joints are done; the other bone matrices are left as they were.
+inline void poseToBoneMatrices(const Skeleton& skeleton, const PoseBuffer& pose, std::vector<glm::mat4>& globals,
+                               std::vector<glm::mat4>& boneMatrices, unsigned int jointLimit = ~0u)
+{
+    const unsigned int jointCount = std::min(jointLimit, static_cast<unsigned int>(skeleton.Joints.size()));
+    globals.resize(pose.Stride);
+    boneMatrices.resize(skeleton.BoneCount, glm::mat4(1.0f));
+
+    const float* tx = pose.Channel(PoseBuffer::TX);
+    const float* ty = pose.Channel(PoseBuffer::TY);
+    const float* tz = pose.Channel(PoseBuffer::TZ);
+    const float* rx = pose.Channel(PoseBuffer::RX);
+    const float* ry = pose.Channel(PoseBuffer::RY);
+    const float* rz = pose.Channel(PoseBuffer::RZ);
+    const float* rw = pose.Channel(PoseBuffer::RW);
+    const float* sx = pose.Channel(PoseBuffer::SX);
+    const float* sy = pose.Channel(PoseBuffer::SY);
+    const float* sz = pose.Channel(PoseBuffer::SZ);
+    for (unsigned int i = 0; i < jointCount; i += 4)
+    {
+        // the nine rotation-scale entries for four joints, same formula as glm::mat4_cast
+        float m[9][4];
+#ifdef POSE_BLEND_SSE2
+        __m128 x = _mm_loadu_ps(rx + i), y = _mm_loadu_ps(ry + i), z = _mm_loadu_ps(rz + i), w = _mm_loadu_ps(rw + i);
+        __m128 two = _mm_set1_ps(2.0f), one = _mm_set1_ps(1.0f);
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+        __m128 scaleX = _mm_loadu_ps(sx + i), scaleY = _mm_loadu_ps(sy + i), scaleZ = _mm_loadu_ps(sz + i);
+        _mm_storeu_ps(m[0], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), scaleX));
+        _mm_storeu_ps(m[1], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), scaleX));
+        _mm_storeu_ps(m[2], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), scaleX));
+        _mm_storeu_ps(m[3], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), scaleY));
+        _mm_storeu_ps(m[4], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), scaleY));
+        _mm_storeu_ps(m[5], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), scaleY));
+        _mm_storeu_ps(m[6], _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), scaleZ));
+        _mm_storeu_ps(m[7], _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), scaleZ));
+        _mm_storeu_ps(m[8], _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), scaleZ));
+#else
+        for (unsigned int lane = 0; lane < 4; lane++)
+        {
+            unsigned int j = i + lane;
+            float x = rx[j], y = ry[j], z = rz[j], w = rw[j];
+            m[0][lane] = (1.0f - 2.0f * (y * y + z * z)) * sx[j];
+            m[1][lane] = 2.0f * (x * y + w * z) * sx[j];
+            m[2][lane] = 2.0f * (x * z - w * y) * sx[j];
+            m[3][lane] = 2.0f * (x * y - w * z) * sy[j];
+            m[4][lane] = (1.0f - 2.0f * (x * x + z * z)) * sy[j];
+            m[5][lane] = 2.0f * (y * z + w * x) * sy[j];
+            m[6][lane] = 2.0f * (x * z + w * y) * sz[j];
+            m[7][lane] = 2.0f * (y * z - w * x) * sz[j];
+            m[8][lane] = (1.0f - 2.0f * (x * x + y * y)) * sz[j];
+        }
+#endif
+        for (unsigned int lane = 0; lane < 4; lane++)
+        {
+            unsigned int j = i + lane;
+            glm::mat4& local = globals[j];
+            local[0] = glm::vec4(m[0][lane], m[1][lane], m[2][lane], 0.0f);
+            local[1] = glm::vec4(m[3][lane], m[4][lane], m[5][lane], 0.0f);
+            local[2] = glm::vec4(m[6][lane], m[7][lane], m[8][lane], 0.0f);
+            local[3] = glm::vec4(tx[j], ty[j], tz[j], 1.0f);
+        }
+    }
+
+    for (unsigned int i = 0; i < jointCount; i++)
+    {
+        const Skeleton::Joint& joint = skeleton.Joints[i];
+        if (joint.parent >= 0)
+            multiplyMatrices(globals[joint.parent], globals[i], globals[i]);
+        if (joint.boneId >= 0)
+            multiplyMatrices(globals[i], joint.offset, boneMatrices[joint.boneId]);
+    }
+}
+
+// A one-dimensional blend tree node: clips placed along a parameter (say, speed: stand at 0,
+// walk at 1, run at 2) and blended between the two neighbours of the current value. Playback
+// is by phase rather than time, so clips of different lengths stay in step.
+class BlendSpace1D
+{
+public:
+    void Add(const SkeletonClip* clip, float position)
+    {
+        m_Clips.push_back(Entry{ clip, position });
+        std::sort(m_Clips.begin(), m_Clips.end(), [](const Entry& a, const Entry& b) { return a.position < b.position; });
+    }
+
+    // length of one cycle at this parameter, for advancing the phase: phase += deltaTime / Duration(parameter)
+    float Duration(float parameter) const
+    {
+        unsigned int first, second;
+        float weight;
+        neighbours(parameter, first, second, weight);
+        return m_Clips[first].clip->Duration + (m_Clips[second].clip->Duration - m_Clips[first].clip->Duration) * weight;
+    }
+
+    // phase in [0, 1)
+    void Sample(float parameter, float phase, PoseBuffer& out)
+    {
+        unsigned int first, second;
+        float weight;
+        neighbours(parameter, first, second, weight);
+        samplePose(*m_Clips[first].clip, phase * m_Clips[first].clip->Duration, out);
+        if (first == second || weight <= 0.0f)
+            return;
+        samplePose(*m_Clips[second].clip, phase * m_Clips[second].clip->Duration, m_Scratch);
+        blendPoses(out, m_Scratch, weight, out);
+    }
+
+private:
+    struct Entry {
+        const SkeletonClip* clip;
+        float position;
+    };
+
+    std::vector<Entry> m_Clips;
+    PoseBuffer m_Scratch;
+
+    void neighbours(float parameter, unsigned int& first, unsigned int& second, float& weight) const
+    {
+        first = second = 0;
+        weight = 0.0f;
+        if (parameter <= m_Clips.front().position)
+            return;
+        first = second = static_cast<unsigned int>(m_Clips.size() - 1);
+        if (parameter >= m_Clips.back().position)
+            return;
+        for (unsigned int i = 1; i < m_Clips.size(); i++)
+        {
+            if (parameter < m_Clips[i].position)
+            {
+                first = i - 1;
+                second = i;
+                weight = (parameter - m_Clips[first].position) / (m_Clips[second].position - m_Clips[first].position);
+                return;
+            }
+        }
+    }
+};
+
+// Drop-in for learnopengl's Animator that crossfades instead of cutting. Every clip that was
+// playing when a new one started stays on a stack, each newer layer blended over the result
+// of the ones below it by its fade-in weight; once the top layer is fully in, the rest are
+// dropped. A transition started in the middle of another therefore fades from whatever mix
+// is showing, without a pop.
+class PoseAnimator
+{
+public:
+    // layers beyond this (very fast toggling) drop the oldest, which may pop slightly
+    static const unsigned int MAX_LAYERS = 4;
+
+    PoseAnimator(const Skeleton& skeleton, const SkeletonClip* clip)
+        : m_Skeleton(skeleton)
+    {
+        m_Pose.Resize(static_cast<unsigned int>(skeleton.Joints.size()));
+        m_Scratch.Resize(static_cast<unsigned int>(skeleton.Joints.size()));
+        PlayAnimation(clip, 0.0f);
+        UpdateAnimation(0.0f);
+    }
+
+    // a fade of 0 is a hard cut; playing the clip that is already current does nothing
+    void PlayAnimation(const SkeletonClip* clip, float fadeSeconds = 0.25f)
+    {
+        if (!m_Layers.empty() && m_Layers.back().clip == clip)
+            return;
+        if (fadeSeconds <= 0.0f)
+            m_Layers.clear();
+        if (m_Layers.size() == MAX_LAYERS)
+            m_Layers.erase(m_Layers.begin());
+        Layer layer;
+        layer.clip = clip;
+        layer.time = 0.0f;
+        layer.weight = m_Layers.empty() ? 1.0f : 0.0f;
+        layer.fadeRate = fadeSeconds > 0.0f ? 1.0f / fadeSeconds : 0.0f;
+        m_Layers.push_back(layer);
+    }
+
+    void UpdateAnimation(float deltaTime)
+    {
+        for (Layer& layer : m_Layers)
+        {
+            layer.time = std::fmod(layer.time + deltaTime, layer.clip->Duration);
+            layer.weight = std::min(1.0f, layer.weight + layer.fadeRate * deltaTime);
+        }
+        if (m_Layers.back().weight >= 1.0f)
+            m_Layers.erase(m_Layers.begin(), m_Layers.end() - 1);
+
+        samplePose(*m_Layers[0].clip, m_Layers[0].time, m_Pose);
+        for (unsigned int i = 1; i < m_Layers.size(); i++)
+        {
+            samplePose(*m_Layers[i].clip, m_Layers[i].time, m_Scratch);
+            blendPoses(m_Pose, m_Scratch, m_Layers[i].weight, m_Pose);
+        }
+        poseToBoneMatrices(m_Skeleton, m_Pose, m_Globals, m_FinalBoneMatrices);
+    }
+
+    const SkeletonClip* GetCurrentAnimation() const { return m_Layers.back().clip; }
+    bool IsBlending() const { return m_Layers.size() > 1; }
+    const PoseBuffer& Pose() const { return m_Pose; }
+    const std::vector<glm::mat4>& GetFinalBoneMatrices() const { return m_FinalBoneMatrices; }
+
+private:
+    struct Layer {
+        const SkeletonClip* clip;
+        float time;
+        float weight;
+        float fadeRate;
+    };
+
+    const Skeleton& m_Skeleton;
+    std::vector<Layer> m_Layers;    // oldest first; the last is the current clip
+    PoseBuffer m_Pose;
+    PoseBuffer m_Scratch;
+    std::vector<glm::mat4> m_Globals;
+    std::vector<glm::mat4> m_FinalBoneMatrices;
+};
+
+#endif
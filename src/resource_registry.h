@@ -0,0 +1,319 @@
+#ifndef RESOURCE_REGISTRY_H
+#define RESOURCE_REGISTRY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum ResourceCategory {
+    RESOURCE_TEXTURE,
+    RESOURCE_MESH,
+    RESOURCE_ANIMATION,
+    RESOURCE_SCENE,
+    RESOURCE_NAVIGATION,
+    RESOURCE_CATEGORY_COUNT
+};
+
+inline const char* resourceCategoryName(ResourceCategory category)
+{
+    static const char* names[RESOURCE_CATEGORY_COUNT] = { "textures", "meshes", "animation", "scene", "navigation" };
+    return category < RESOURCE_CATEGORY_COUNT ? names[category] : "unknown";
+}
+
+// "12.3 MB"; for messages, snapshots keep exact byte counts
+inline std::string formatBytes(size_t bytes)
+{
+    char text[32];
+    if (bytes >= 1024 * 1024)
+        std::snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024.0));
+    else
+        std::snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    return text;
+}
+
+struct ResourceUsage {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+    unsigned int assets = 0;
+};
+
+// 0 means no limit
+struct ResourceBudget {
+    size_t cpuBytes = 0;
+    size_t gpuBytes = 0;
+};
+
+// Bytes held by every loaded asset, on the CPU and on the GPU, by category. Loaders report what
+// they allocate; the registry adds it up, warns once when a category (or the total) goes over
+// its budget, picks the least recently used evictable assets to free, and writes JSON snapshots
+// with one asset per line so two of them diff cleanly. It only counts: nothing is freed here.
+// Not thread-safe; use it from the thread that owns the resources.
+class ResourceRegistry
+{
+public:
+    static const unsigned int INVALID = ~0u;
+
+    // adds the asset, or replaces the sizes of the one already tracked under this name; returns its handle
+    unsigned int Track(ResourceCategory category, const std::string& name, size_t cpuBytes, size_t gpuBytes, bool evictable = false)
+    {
+        auto found = m_ByName.find(name);
+        unsigned int handle;
+        if (found != m_ByName.end())
+        {
+            handle = found->second;
+            remove(m_Assets[handle]);
+        }
+        else if (!m_Free.empty())
+        {
+            handle = m_Free.back();
+            m_Free.pop_back();
+            m_ByName[name] = handle;
+        }
+        else
+        {
+            handle = static_cast<unsigned int>(m_Assets.size());
+            m_Assets.emplace_back();
+            m_ByName[name] = handle;
+        }
+        Asset& asset = m_Assets[handle];
+        asset.name = name;
+        asset.category = category;
+        asset.cpuBytes = cpuBytes;
+        asset.gpuBytes = gpuBytes;
+        asset.evictable = evictable;
+        asset.live = true;
+        asset.lastUsed = m_Frame;
+        add(asset);
+        return handle;
+    }
+
+    // new sizes for an asset that grows or shrinks, such as a streaming pool
+    void Update(unsigned int handle, size_t cpuBytes, size_t gpuBytes)
+    {
+        Asset& asset = m_Assets[handle];
+        remove(asset);
+        asset.cpuBytes = cpuBytes;
+        asset.gpuBytes = gpuBytes;
+        add(asset);
+    }
+
+    void Untrack(unsigned int handle)
+    {
+        Asset& asset = m_Assets[handle];
+        if (!asset.live)
+            return;
+        remove(asset);
+        asset.live = false;
+        m_ByName.erase(asset.name);
+        m_Free.push_back(handle);
+    }
+
+    unsigned int Find(const std::string& name) const
+    {
+        auto found = m_ByName.find(name);
+        return found != m_ByName.end() ? found->second : INVALID;
+    }
+
+    const std::string& Name(unsigned int handle) const { return m_Assets[handle].name; }
+
+    // marks the asset as used this frame; eviction prefers what was used longest ago
+    void Touch(unsigned int handle) { m_Assets[handle].lastUsed = m_Frame; }
+    void NextFrame() { m_Frame++; }
+    unsigned long long Frame() const { return m_Frame; }
+
+    void SetBudget(ResourceCategory category, const ResourceBudget& budget) { m_Budgets[category] = budget; }
+    void SetTotalBudget(const ResourceBudget& budget) { m_Budgets[RESOURCE_CATEGORY_COUNT] = budget; }
+    const ResourceBudget& Budget(ResourceCategory category) const { return m_Budgets[category]; }
+
+    const ResourceUsage& Usage(ResourceCategory category) const { return m_Usage[category]; }
+    const ResourceUsage& Total() const { return m_Usage[RESOURCE_CATEGORY_COUNT]; }
+
+    // Prints a warning for each budget that was crossed since the last check, naming what could
+    // be evicted to get back under, and a note when one is back under. Returns how many budgets
+    // are exceeded now.
+    unsigned int CheckBudgets()
+    {
+        unsigned int over = 0;
+        for (unsigned int i = 0; i <= RESOURCE_CATEGORY_COUNT; i++)
+            for (int gpu = 0; gpu < 2; gpu++)
+            {
+                size_t limit = gpu ? m_Budgets[i].gpuBytes : m_Budgets[i].cpuBytes;
+                size_t used = gpu ? m_Usage[i].gpuBytes : m_Usage[i].cpuBytes;
+                bool exceeded = limit != 0 && used > limit;
+                const char* name = i < RESOURCE_CATEGORY_COUNT ? resourceCategoryName(static_cast<ResourceCategory>(i)) : "total";
+                if (exceeded && !m_Exceeded[i][gpu])
+                {
+                    std::cout << "WARNING::RESOURCES::BUDGET_EXCEEDED " << name << (gpu ? " GPU " : " CPU ") << formatBytes(used)
+                              << " of " << formatBytes(limit);
+                    std::vector<unsigned int> candidates;
+                    evictionCandidates(i, candidates);
+                    if (!candidates.empty())
+                        std::cout << "; least recently used: " << describe(candidates);
+                    std::cout << std::endl;
+                }
+                else if (!exceeded && m_Exceeded[i][gpu])
+                {
+                    std::cout << "Resources: " << name << (gpu ? " GPU " : " CPU ") << "back under budget at " << formatBytes(used) << std::endl;
+                }
+                m_Exceeded[i][gpu] = exceeded;
+                over += exceeded;
+            }
+        return over;
+    }
+
+    // Evictable assets of the category, least recently used first, just enough of them that
+    // freeing them all would bring it back under budget (out is empty when it is under).
+    // The caller frees them and calls Untrack.
+    void EvictionCandidates(ResourceCategory category, std::vector<unsigned int>& out) const { evictionCandidates(category, out); }
+
+    // the same for the total budget, drawing on every category
+    void TotalEvictionCandidates(std::vector<unsigned int>& out) const { evictionCandidates(RESOURCE_CATEGORY_COUNT, out); }
+
+    // Totals, categories with their budgets, then every asset sorted by category and name, one
+    // per line. Only sizes are written (not frames or use times), so snapshots of the same
+    // content are identical and a diff shows exactly what grew.
+    bool WriteSnapshot(const std::string& path) const
+    {
+        std::ofstream out(path, std::ios::trunc);
+        if (!out)
+        {
+            std::cout << "ERROR::RESOURCES::FAILED_TO_OPEN_FOR_WRITING " << path << std::endl;
+            return false;
+        }
+        const ResourceUsage& total = Total();
+        out << "{\n  \"total\": { \"cpuBytes\": " << total.cpuBytes << ", \"gpuBytes\": " << total.gpuBytes
+            << ", \"assets\": " << total.assets << ", \"cpuBudget\": " << m_Budgets[RESOURCE_CATEGORY_COUNT].cpuBytes
+            << ", \"gpuBudget\": " << m_Budgets[RESOURCE_CATEGORY_COUNT].gpuBytes << " },\n  \"categories\": {\n";
+        for (unsigned int i = 0; i < RESOURCE_CATEGORY_COUNT; i++)
+            out << "    \"" << resourceCategoryName(static_cast<ResourceCategory>(i)) << "\": { \"cpuBytes\": " << m_Usage[i].cpuBytes
+                << ", \"gpuBytes\": " << m_Usage[i].gpuBytes << ", \"assets\": " << m_Usage[i].assets << ", \"cpuBudget\": "
+                << m_Budgets[i].cpuBytes << ", \"gpuBudget\": " << m_Budgets[i].gpuBytes << " }" << (i + 1 < RESOURCE_CATEGORY_COUNT ? "," : "") << "\n";
+        out << "  },\n  \"assets\": [\n";
+
+        std::vector<unsigned int> order;
+        for (unsigned int i = 0; i < m_Assets.size(); i++)
+            if (m_Assets[i].live)
+                order.push_back(i);
+        std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+            return m_Assets[a].category != m_Assets[b].category ? m_Assets[a].category < m_Assets[b].category : m_Assets[a].name < m_Assets[b].name;
+        });
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const Asset& asset = m_Assets[order[i]];
+            out << "    { \"category\": \"" << resourceCategoryName(asset.category) << "\", \"name\": \"" << escape(asset.name)
+                << "\", \"cpuBytes\": " << asset.cpuBytes << ", \"gpuBytes\": " << asset.gpuBytes
+                << ", \"evictable\": " << (asset.evictable ? "true" : "false") << " }" << (i + 1 < order.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n}\n";
+        return static_cast<bool>(out);
+    }
+
+private:
+    struct Asset {
+        std::string name;
+        ResourceCategory category = RESOURCE_TEXTURE;
+        size_t cpuBytes = 0;
+        size_t gpuBytes = 0;
+        bool evictable = false;
+        bool live = false;
+        unsigned long long lastUsed = 0;
+    };
+
+    std::vector<Asset> m_Assets;
+    std::vector<unsigned int> m_Free;
+    std::unordered_map<std::string, unsigned int> m_ByName;
+    // one slot per category plus the total at RESOURCE_CATEGORY_COUNT
+    ResourceUsage m_Usage[RESOURCE_CATEGORY_COUNT + 1];
+    ResourceBudget m_Budgets[RESOURCE_CATEGORY_COUNT + 1];
+    bool m_Exceeded[RESOURCE_CATEGORY_COUNT + 1][2] = {};
+    unsigned long long m_Frame = 0;
+
+    void add(const Asset& asset)
+    {
+        for (ResourceUsage* usage : { &m_Usage[asset.category], &m_Usage[RESOURCE_CATEGORY_COUNT] })
+        {
+            usage->cpuBytes += asset.cpuBytes;
+            usage->gpuBytes += asset.gpuBytes;
+            usage->assets++;
+        }
+    }
+
+    void remove(const Asset& asset)
+    {
+        for (ResourceUsage* usage : { &m_Usage[asset.category], &m_Usage[RESOURCE_CATEGORY_COUNT] })
+        {
+            usage->cpuBytes -= asset.cpuBytes;
+            usage->gpuBytes -= asset.gpuBytes;
+            usage->assets--;
+        }
+    }
+
+    // slot is a category, or RESOURCE_CATEGORY_COUNT for the total
+    void evictionCandidates(unsigned int slot, std::vector<unsigned int>& out) const
+    {
+        out.clear();
+        const ResourceBudget& budget = m_Budgets[slot];
+        size_t cpu = m_Usage[slot].cpuBytes, gpu = m_Usage[slot].gpuBytes;
+        auto over = [&]() {
+            return (budget.cpuBytes != 0 && cpu > budget.cpuBytes) || (budget.gpuBytes != 0 && gpu > budget.gpuBytes);
+        };
+        if (!over())
+            return;
+        std::vector<unsigned int> candidates;
+        for (unsigned int i = 0; i < m_Assets.size(); i++)
+            if (m_Assets[i].live && m_Assets[i].evictable && (slot == RESOURCE_CATEGORY_COUNT || m_Assets[i].category == slot))
+                candidates.push_back(i);
+        std::sort(candidates.begin(), candidates.end(), [&](unsigned int a, unsigned int b) {
+            return m_Assets[a].lastUsed != m_Assets[b].lastUsed ? m_Assets[a].lastUsed < m_Assets[b].lastUsed
+                                                                : m_Assets[a].cpuBytes + m_Assets[a].gpuBytes > m_Assets[b].cpuBytes + m_Assets[b].gpuBytes;
+        });
+        for (unsigned int handle : candidates)
+        {
+            if (!over())
+                break;
+            // skip what frees nothing on the side that is over, such as a texture for a CPU total
+            const Asset& asset = m_Assets[handle];
+            if (!(budget.cpuBytes != 0 && cpu > budget.cpuBytes && asset.cpuBytes != 0) && !(budget.gpuBytes != 0 && gpu > budget.gpuBytes && asset.gpuBytes != 0))
+                continue;
+            out.push_back(handle);
+            cpu -= m_Assets[handle].cpuBytes;
+            gpu -= m_Assets[handle].gpuBytes;
+        }
+    }
+
+    std::string describe(const std::vector<unsigned int>& handles) const
+    {
+        std::string text;
+        for (size_t i = 0; i < handles.size() && i < 5; i++)
+            text += (i ? ", " : "") + m_Assets[handles[i]].name + " (" + formatBytes(m_Assets[handles[i]].cpuBytes + m_Assets[handles[i]].gpuBytes) + ")";
+        if (handles.size() > 5)
+            text += " and " + std::to_string(handles.size() - 5) + " more";
+        return text;
+    }
+
+    static std::string escape(const std::string& text)
+    {
+        std::string result;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                result += '\\';
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char code[8];
+                std::snprintf(code, sizeof(code), "\\u%04x", c);
+                result += code;
+                continue;
+            }
+            result += c;
+        }
+        return result;
+    }
+};
+
+#endif
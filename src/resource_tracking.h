@@ -0,0 +1,84 @@
+#ifndef RESOURCE_TRACKING_H
+#define RESOURCE_TRACKING_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/mesh.h>
+
+#include "resource_registry.h"
+#include "skeleton.h"
+
+#include <string>
+
+// Sizes of GL and learnopengl resources for the ResourceRegistry. GPU sizes are what the driver
+// needs at least; drivers add alignment and padding on top.
+
+// path relative to the resource root, so snapshots from different checkouts diff cleanly
+inline std::string resourceName(const std::string& path)
+{
+    std::string root = FileSystem::getPath("");
+    if (!root.empty() && path.compare(0, root.size(), root) == 0)
+        return path.substr(root.size());
+    return path;
+}
+
+// every mip level of a 2D texture, read back from GL so it works for textures loaded anywhere
+inline size_t textureGpuBytes(unsigned int texture)
+{
+    GLint previous = 0;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previous);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    size_t bytes = 0;
+    for (int level = 0; level < 16; level++)
+    {
+        GLint width = 0, height = 0, format = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        if (width == 0 || height == 0)
+            break;
+        size_t texel = 4;   // RGB8 is padded to four bytes by every driver we know of
+        if (format == GL_RED || format == GL_R8)
+            texel = 1;
+        else if (format == GL_RG || format == GL_RG8)
+            texel = 2;
+        else if (format == GL_RGBA16F)
+            texel = 8;
+        else if (format == GL_RGB32F)
+            texel = 12;
+        else if (format == GL_RGBA32F)
+            texel = 16;
+        bytes += static_cast<size_t>(width) * height * texel;
+    }
+    glBindTexture(GL_TEXTURE_2D, static_cast<unsigned int>(previous));
+    return bytes;
+}
+
+// the image data is freed after upload, so a texture only costs GPU memory; textures can be
+// reloaded from disk, which makes them evictable
+inline unsigned int trackTexture(ResourceRegistry& registry, const std::string& path, unsigned int texture)
+{
+    return registry.Track(RESOURCE_TEXTURE, resourceName(path), 0, textureGpuBytes(texture), true);
+}
+
+// A learnopengl Model (or animated Model) keeps its vertices and indices on the CPU after
+// uploading the same data to its VBOs and EBOs. Its textures are tracked separately, under
+// their own paths.
+template <typename ModelType>
+inline unsigned int trackModel(ResourceRegistry& registry, const std::string& path, ModelType& model)
+{
+    size_t bytes = 0;
+    for (const Mesh& mesh : model.meshes)
+        bytes += mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+    for (const Texture& texture : model.textures_loaded)
+        trackTexture(registry, model.directory + "/" + texture.path, texture.id);
+    return registry.Track(RESOURCE_MESH, resourceName(path), bytes, bytes);
+}
+
+inline unsigned int trackClip(ResourceRegistry& registry, const SkeletonClip& clip)
+{
+    return registry.Track(RESOURCE_ANIMATION, clip.Name, clip.MemoryBytes(), 0);
+}
+
+#endif
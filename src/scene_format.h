@@ -0,0 +1,368 @@
+#ifndef SCENE_FORMAT_H
+#define SCENE_FORMAT_H
+
+#include <glm/glm.hpp>
+
+#include "collision.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binary scene layout (native endianness, everything tightly packed):
+//
+//   SceneFileHeader
+//   mesh table      meshCount     x { uint32 type, string path }
+//   material table  materialCount x { vec3 color, uint32 flags, string texturePath }
+//   chunk table     chunkCount    x SceneChunkRecord       (at header.chunkTableOffset)
+//   chunk payloads  entityCount   x SceneEntity            (at record.offset)
+//
+// Strings are a uint32 byte count followed by the bytes. The tables are small and read once
+// when the scene is opened; chunk payloads are read on demand by the world streamer.
+
+const char SCENE_MAGIC[4] = { 'S', 'C', 'N', 'B' };
+const uint32_t SCENE_VERSION = 2;
+
+enum SceneMeshType : uint32_t {
+    SCENE_MESH_CUBE = 0,
+    SCENE_MESH_PLANE = 1,
+    SCENE_MESH_MODEL = 2
+};
+
+enum SceneMaterialFlags : uint32_t {
+    SCENE_MATERIAL_TEXTURED = 1 << 0
+};
+
+enum SceneEntityFlags : uint32_t {
+    SCENE_ENTITY_COLLIDER = 1 << 0,
+    SCENE_ENTITY_OCCLUDER = 1 << 1     // large and solid enough to hide what is behind it
+};
+
+struct SceneMesh {
+    uint32_t type;
+    std::string path;   // only used by SCENE_MESH_MODEL
+};
+
+struct SceneMaterial {
+    glm::vec3 color;
+    uint32_t flags;
+    std::string texturePath;
+};
+
+// one placed object; stored verbatim in chunk payloads
+struct SceneEntity {
+    glm::vec3 position;
+    glm::vec3 scale;
+    float yaw;
+    uint32_t mesh;
+    uint32_t material;
+    uint32_t flags;
+    AABB collider;      // world space, valid when SCENE_ENTITY_COLLIDER is set
+};
+
+struct SceneFileHeader {
+    char magic[4];
+    uint32_t version;
+    float chunkSize;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t chunkCount;
+    uint64_t chunkTableOffset;
+};
+
+struct SceneChunkRecord {
+    int32_t x;
+    int32_t z;
+    uint64_t offset;
+    uint32_t entityCount;
+    uint32_t payloadBytes;
+    AABB bounds;
+};
+
+static_assert(std::is_trivially_copyable<SceneEntity>::value, "SceneEntity is written to disk as raw bytes");
+static_assert(std::is_trivially_copyable<SceneChunkRecord>::value, "SceneChunkRecord is written to disk as raw bytes");
+
+// everything needed to cook a scene file; entities are bucketed into chunks by position
+struct SceneDescription {
+    float chunkSize = 20.0f;
+    std::vector<SceneMesh> meshes;
+    std::vector<SceneMaterial> materials;
+    std::vector<SceneEntity> entities;
+};
+
+inline glm::ivec2 sceneChunkCoord(const glm::vec3& position, float chunkSize)
+{
+    return glm::ivec2(static_cast<int>(std::floor(position.x / chunkSize)),
+                      static_cast<int>(std::floor(position.z / chunkSize)));
+}
+
+inline AABB sceneEntityBounds(const SceneEntity& entity)
+{
+    if (entity.flags & SCENE_ENTITY_COLLIDER)
+        return entity.collider;
+    // conservative box for the rotated, scaled unit mesh
+    glm::vec3 halfExtent = entity.scale * 0.5f;
+    float radiusXZ = std::sqrt(halfExtent.x * halfExtent.x + halfExtent.z * halfExtent.z);
+    glm::vec3 extent(radiusXZ, halfExtent.y, radiusXZ);
+    return AABB{ entity.position - extent, entity.position + extent };
+}
+
+namespace scene_io {
+    template <typename T>
+    inline void writeRaw(std::ofstream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template <typename T>
+    inline bool readRaw(std::ifstream& in, T& value)
+    {
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return static_cast<bool>(in);
+    }
+
+    inline void writeString(std::ofstream& out, const std::string& value)
+    {
+        writeRaw(out, static_cast<uint32_t>(value.size()));
+        out.write(value.data(), value.size());
+    }
+
+    // maxLength guards the allocation against a corrupt length
+    inline bool readString(std::ifstream& in, std::string& value, uint64_t maxLength = UINT32_MAX)
+    {
+        uint32_t length = 0;
+        if (!readRaw(in, length) || length > maxLength)
+            return false;
+        value.resize(length);
+        in.read(&value[0], length);
+        return static_cast<bool>(in);
+    }
+}
+
+// cooks a scene description into the chunked binary format
+inline bool writeSceneFile(const std::string& path, const SceneDescription& scene)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::SCENE::FAILED_TO_OPEN_FOR_WRITING " << path << std::endl;
+        return false;
+    }
+
+    // bucket entities by chunk; std::map keeps chunk order (and so the file) deterministic
+    std::map<std::pair<int, int>, std::vector<SceneEntity>> buckets;
+    for (const SceneEntity& entity : scene.entities)
+    {
+        glm::ivec2 coord = sceneChunkCoord(entity.position, scene.chunkSize);
+        buckets[std::make_pair(coord.x, coord.y)].push_back(entity);
+    }
+
+    SceneFileHeader header;
+    std::memcpy(header.magic, SCENE_MAGIC, sizeof(header.magic));
+    header.version = SCENE_VERSION;
+    header.chunkSize = scene.chunkSize;
+    header.meshCount = static_cast<uint32_t>(scene.meshes.size());
+    header.materialCount = static_cast<uint32_t>(scene.materials.size());
+    header.chunkCount = static_cast<uint32_t>(buckets.size());
+    header.chunkTableOffset = 0;
+    scene_io::writeRaw(out, header);
+
+    for (const SceneMesh& mesh : scene.meshes)
+    {
+        scene_io::writeRaw(out, mesh.type);
+        scene_io::writeString(out, mesh.path);
+    }
+    for (const SceneMaterial& material : scene.materials)
+    {
+        scene_io::writeRaw(out, material.color);
+        scene_io::writeRaw(out, material.flags);
+        scene_io::writeString(out, material.texturePath);
+    }
+
+    header.chunkTableOffset = static_cast<uint64_t>(out.tellp());
+    uint64_t payloadOffset = header.chunkTableOffset + buckets.size() * sizeof(SceneChunkRecord);
+
+    std::vector<SceneChunkRecord> records;
+    for (const auto& bucket : buckets)
+    {
+        SceneChunkRecord record;
+        record.x = bucket.first.first;
+        record.z = bucket.first.second;
+        record.offset = payloadOffset;
+        record.entityCount = static_cast<uint32_t>(bucket.second.size());
+        record.payloadBytes = static_cast<uint32_t>(bucket.second.size() * sizeof(SceneEntity));
+        record.bounds = AABB{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+        for (const SceneEntity& entity : bucket.second)
+        {
+            AABB bounds = sceneEntityBounds(entity);
+            record.bounds.min = glm::min(record.bounds.min, bounds.min);
+            record.bounds.max = glm::max(record.bounds.max, bounds.max);
+        }
+        records.push_back(record);
+        payloadOffset += record.payloadBytes;
+    }
+
+    for (const SceneChunkRecord& record : records)
+        scene_io::writeRaw(out, record);
+    for (const auto& bucket : buckets)
+        out.write(reinterpret_cast<const char*>(bucket.second.data()), bucket.second.size() * sizeof(SceneEntity));
+
+    // patch the header now that the chunk table offset is known
+    out.seekp(0);
+    scene_io::writeRaw(out, header);
+    return static_cast<bool>(out);
+}
+
+// read-only view of a cooked scene: the tables are loaded up front, chunk payloads on request
+class SceneFile
+{
+public:
+    std::string Path;
+    float ChunkSize = 0.0f;
+    std::vector<SceneMesh> Meshes;
+    std::vector<SceneMaterial> Materials;
+    std::vector<SceneChunkRecord> Chunks;
+
+    bool Load(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            std::cout << "ERROR::SCENE::FILE_NOT_FOUND " << path << std::endl;
+            return false;
+        }
+
+        SceneFileHeader header;
+        if (!scene_io::readRaw(in, header) || std::memcmp(header.magic, SCENE_MAGIC, sizeof(header.magic)) != 0)
+        {
+            std::cout << "ERROR::SCENE::NOT_A_SCENE_FILE " << path << std::endl;
+            return false;
+        }
+        if (header.version != SCENE_VERSION)
+        {
+            std::cout << "ERROR::SCENE::UNSUPPORTED_VERSION " << header.version << " in " << path << std::endl;
+            return false;
+        }
+
+        // every count and offset is checked against the file size before anything is allocated or
+        // read, so a stale or corrupt file is rejected instead of overrunning a buffer
+        in.seekg(0, std::ios::end);
+        uint64_t fileSize = static_cast<uint64_t>(in.tellg());
+        in.seekg(sizeof(SceneFileHeader));
+        if (header.meshCount > fileSize / (2 * sizeof(uint32_t)) || header.materialCount > fileSize / (sizeof(glm::vec3) + 2 * sizeof(uint32_t)) ||
+            header.chunkTableOffset > fileSize || header.chunkCount > (fileSize - header.chunkTableOffset) / sizeof(SceneChunkRecord))
+            return failCorrupt(path, "table sizes");
+        // chunk coordinates divide by it and cast to int
+        if (!std::isfinite(header.chunkSize) || header.chunkSize <= 0.0f)
+            return failCorrupt(path, "chunk size");
+
+        Path = path;
+        ChunkSize = header.chunkSize;
+        Meshes.resize(header.meshCount);
+        for (SceneMesh& mesh : Meshes)
+            if (!scene_io::readRaw(in, mesh.type) || !scene_io::readString(in, mesh.path, fileSize))
+                return failTruncated();
+        Materials.resize(header.materialCount);
+        for (SceneMaterial& material : Materials)
+            if (!scene_io::readRaw(in, material.color) || !scene_io::readRaw(in, material.flags) || !scene_io::readString(in, material.texturePath, fileSize))
+                return failTruncated();
+
+        in.seekg(static_cast<std::streamoff>(header.chunkTableOffset));
+        Chunks.resize(header.chunkCount);
+        if (header.chunkCount > 0)
+        {
+            in.read(reinterpret_cast<char*>(Chunks.data()), Chunks.size() * sizeof(SceneChunkRecord));
+            if (!in)
+                return failTruncated();
+        }
+
+        // payloads must hold exactly their entities, inside the file and after the chunk table.
+        // Only the records are checked here, so opening a world doesn't read it all; the entities'
+        // mesh and material indices are checked by LoadChunk as each chunk streams in
+        uint64_t payloadStart = header.chunkTableOffset + Chunks.size() * sizeof(SceneChunkRecord);
+        for (const SceneChunkRecord& record : Chunks)
+            if (record.payloadBytes != static_cast<uint64_t>(record.entityCount) * sizeof(SceneEntity) ||
+                record.offset < payloadStart || record.offset > fileSize || record.payloadBytes > fileSize - record.offset)
+                return failCorrupt(path, "chunk record");
+
+        m_ChunkLookup.clear();
+        for (unsigned int i = 0; i < Chunks.size(); i++)
+            m_ChunkLookup[std::make_pair(Chunks[i].x, Chunks[i].z)] = static_cast<int>(i);
+        return true;
+    }
+
+    // index into Chunks, or -1 when the chunk is empty / outside the world
+    int FindChunk(int x, int z) const
+    {
+        auto it = m_ChunkLookup.find(std::make_pair(x, z));
+        return it == m_ChunkLookup.end() ? -1 : it->second;
+    }
+
+    // reads one chunk's entities; opens its own stream so it is safe to call from worker threads.
+    // Load validated the record; the entities' mesh and material indices are checked here
+    bool LoadChunk(int index, std::vector<SceneEntity>& entities) const
+    {
+        const SceneChunkRecord& record = Chunks[index];
+        std::ifstream in(Path, std::ios::binary);
+        if (!readEntities(in, record, entities) || !validEntities(entities))
+        {
+            std::cout << "ERROR::SCENE::FAILED_TO_READ_CHUNK " << record.x << "," << record.z << std::endl;
+            entities.clear();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::map<std::pair<int, int>, int> m_ChunkLookup;
+
+    static bool readEntities(std::ifstream& in, const SceneChunkRecord& record, std::vector<SceneEntity>& entities)
+    {
+        in.seekg(static_cast<std::streamoff>(record.offset));
+        entities.resize(record.entityCount);
+        if (record.entityCount > 0)
+            in.read(reinterpret_cast<char*>(entities.data()), entities.size() * sizeof(SceneEntity));
+        return static_cast<bool>(in);
+    }
+
+    bool validEntities(const std::vector<SceneEntity>& entities) const
+    {
+        for (const SceneEntity& entity : entities)
+            if (entity.mesh >= Meshes.size() || entity.material >= Materials.size())
+                return false;
+        return true;
+    }
+
+    bool failTruncated()
+    {
+        std::cout << "ERROR::SCENE::TRUNCATED_FILE " << Path << std::endl;
+        clear();
+        return false;
+    }
+
+    bool failCorrupt(const std::string& path, const char* what)
+    {
+        std::cout << "ERROR::SCENE::CORRUPT_FILE " << path << " (" << what << ")" << std::endl;
+        clear();
+        return false;
+    }
+
+    void clear()
+    {
+        Path.clear();
+        Meshes.clear();
+        Materials.clear();
+        Chunks.clear();
+        m_ChunkLookup.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include <glm/glm.hpp>
+
+#include "animation_format.h"
+#include "collision.h"
+#include "job_system.h"
+#include "player_simulation.h"
+#include "pose_blend.h"
+#include "scene_format.h"
+#include "skeleton.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Authoritative player simulation with no window, GL or assimp: the scene's colliders, the same
+// stepPlayer the demo runs, and walk/stand pose evaluation from a cooked animation file, for
+// thousands of independent sessions at a fixed tick. Input comes from scripted bots here; a
+// network front end would feed PlayerInputSource the same way.
+//
+//   simulation_server [sessions] [seconds] [--realtime] [--scene path] [--animations path]
+//
+// Without --realtime the ticks run back to back and the result is the tick throughput. With it,
+// ticks are paced at 60 Hz and the result is how much of each tick the simulation used.
+
+// wanders: keeps a heading and a set of keys for one to three seconds, then picks new ones
+class ScriptedInput : public PlayerInputSource
+{
+public:
+    ScriptedInput(unsigned int seed)
+        : m_Seed(seed)
+    {
+        m_Input.yaw = random01() * 360.0f;
+    }
+
+    PlayerInput Poll() override
+    {
+        if (m_TicksLeft == 0)
+        {
+            float action = random01();
+            m_Input.forward = action < 0.6f;
+            m_Input.back = action >= 0.6f && action < 0.7f;
+            m_Input.left = random01() < 0.15f;
+            m_Input.right = !m_Input.left && random01() < 0.15f;
+            m_Input.yaw += (random01() - 0.5f) * 120.0f;
+            m_TicksLeft = 60 + static_cast<unsigned int>(random01() * 120.0f);
+        }
+        m_TicksLeft--;
+        PlayerInput input = m_Input;
+        input.jump = random01() < 0.01f;
+        return input;
+    }
+
+private:
+    unsigned int m_Seed;
+    unsigned int m_TicksLeft = 0;
+    PlayerInput m_Input;
+
+    float random01()
+    {
+        m_Seed = m_Seed * 1664525u + 1013904223u;
+        return static_cast<float>(m_Seed >> 8) / static_cast<float>(1 << 24);
+    }
+};
+
+struct Session {
+    PlayerState player;
+    std::unique_ptr<PlayerInputSource> input;
+    std::unique_ptr<PoseAnimator> animator;     // empty when no animation file was loaded
+    std::vector<AABB> nearby;                   // scratch, per session so ticks need no locking
+};
+
+int main(int argc, char** argv)
+{
+    unsigned int sessionCount = 4096;
+    float seconds = 10.0f;
+    bool realtime = false;
+    std::string scenePath = "resources/scenes/default.scene";
+    std::string animationPath = "resources/animations/character.anim";
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string argument = argv[i];
+        if (argument == "--realtime")
+            realtime = true;
+        else if (argument == "--scene" && i + 1 < argc)
+            scenePath = argv[++i];
+        else if (argument == "--animations" && i + 1 < argc)
+            animationPath = argv[++i];
+        else
+            positional.push_back(argument);
+    }
+    if (positional.size() > 0)
+        sessionCount = static_cast<unsigned int>(std::max(1, std::atoi(positional[0].c_str())));
+    if (positional.size() > 1)
+        seconds = static_cast<float>(std::atof(positional[1].c_str()));
+
+    // the world: every collider of every chunk, bucketed by chunk so a player only tests its neighbourhood
+    SceneFile scene;
+    if (!scene.Load(scenePath))
+    {
+        std::cout << "Run model_loading once to cook the scene, or pass --scene" << std::endl;
+        return 1;
+    }
+    CollisionGrid world(scene.ChunkSize);
+    std::vector<SceneEntity> entities;
+    for (unsigned int chunk = 0; chunk < scene.Chunks.size(); chunk++)
+    {
+        scene.LoadChunk(static_cast<int>(chunk), entities);
+        for (const SceneEntity& entity : entities)
+            if (entity.flags & SCENE_ENTITY_COLLIDER)
+                world.Add(entity.collider);
+    }
+    float worldExtent = scene.ChunkSize * 4.0f;
+
+    // poses are optional: a server that only needs movement runs without the file
+    Skeleton skeleton;
+    std::vector<SkeletonClip> clips;
+    bool poses = readAnimationFile(animationPath, skeleton, clips) && clips.size() >= 2;
+    if (!poses)
+        std::cout << "No walk/stand clips in " << animationPath << " (run skeletal_animation once to cook them); simulating movement only" << std::endl;
+    const SkeletonClip* walkClip = poses ? &clips[0] : nullptr;
+    const SkeletonClip* standClip = poses ? &clips[1] : nullptr;
+
+    std::vector<Session> sessions(sessionCount);
+    unsigned int seed = 99u;
+    auto random01 = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+    for (unsigned int i = 0; i < sessionCount; i++)
+    {
+        Session& session = sessions[i];
+        session.player.position = glm::vec3((random01() * 2.0f - 1.0f) * worldExtent, 0.5f, (random01() * 2.0f - 1.0f) * worldExtent);
+        session.input.reset(new ScriptedInput(i * 7919u + 1u));
+        if (poses)
+            session.animator.reset(new PoseAnimator(skeleton, standClip));
+    }
+
+    JobSystem jobs;
+    PlayerSettings settings;
+    FixedTimestep timestep(60.0f);
+    const unsigned int ticks = std::max(1u, static_cast<unsigned int>(seconds / timestep.Step + 0.5f));
+    // sessions per job, so scheduling overhead stays small next to the work
+    const unsigned int batch = 64;
+    const unsigned int batches = (sessionCount + batch - 1) / batch;
+
+    std::cout << "simulation_server: " << sessionCount << " sessions, " << world.ColliderCount() << " colliders, "
+              << (poses ? std::to_string(skeleton.Joints.size()) + "-joint poses" : std::string("no poses")) << ", "
+              << ticks << " ticks at " << 1.0f / timestep.Step << " Hz on " << jobs.ThreadCount() << " worker threads"
+              << (realtime ? ", paced" : "") << std::endl;
+
+    std::vector<float> tickMs;
+    tickMs.reserve(ticks);
+    auto start = std::chrono::steady_clock::now();
+    auto nextTick = start;
+    for (unsigned int tick = 0; tick < ticks; tick++)
+    {
+        auto tickStart = std::chrono::steady_clock::now();
+        jobs.ParallelFor(batches, [&](unsigned int b) {
+            unsigned int end = std::min(sessionCount, (b + 1) * batch);
+            for (unsigned int i = b * batch; i < end; i++)
+            {
+                Session& session = sessions[i];
+                PlayerInput input = session.input->Poll();
+                glm::vec3 reach(settings.halfSize + 1.0f, 1000.0f, settings.halfSize + 1.0f);
+                world.Gather(AABB{ session.player.position - reach, session.player.position + reach }, session.nearby);
+                stepPlayer(session.player, input, settings, session.nearby, timestep.Step);
+                if (session.animator)
+                {
+                    bool moving = input.forward || input.back || input.left || input.right;
+                    session.animator->PlayAnimation(moving ? walkClip : standClip, 0.25f);
+                    session.animator->UpdateAnimation(timestep.Step);
+                }
+            }
+        });
+        tickMs.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - tickStart).count());
+
+        if (realtime)
+        {
+            nextTick += std::chrono::microseconds(static_cast<long long>(timestep.Step * 1e6f));
+            std::this_thread::sleep_until(nextTick);
+        }
+    }
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<float> sorted = tickMs;
+    std::sort(sorted.begin(), sorted.end());
+    double totalMs = 0.0;
+    for (float ms : tickMs)
+        totalMs += ms;
+    double meanMs = totalMs / ticks;
+    std::cout << "  " << ticks / (totalMs / 1000.0) << " ticks/s, " << static_cast<double>(ticks) * sessionCount / (totalMs / 1000.0) / 1e6
+              << " M session-ticks/s" << std::endl;
+    std::cout << "  tick " << meanMs << " ms mean, " << sorted[sorted.size() * 99 / 100] << " ms p99, " << sorted.back()
+              << " ms max; " << meanMs / (timestep.Step * 1000.0) * 100.0 << "% of the " << timestep.Step * 1000.0f << " ms budget" << std::endl;
+    if (realtime)
+        std::cout << "  " << wallSeconds << " s wall for " << ticks * timestep.Step << " s simulated" << std::endl;
+
+    // sessions are independent and deterministic, so this is the same for any thread count
+    double checksum = 0.0;
+    for (const Session& session : sessions)
+        checksum += session.player.position.x * 3.0 + session.player.position.y * 5.0 + session.player.position.z * 7.0;
+    std::cout << "  final position checksum " << checksum << std::endl;
+    return 0;
+}
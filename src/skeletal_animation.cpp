@@ -8,16 +8,31 @@
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
-#include <learnopengl/animator.h>
+#include <learnopengl/animation.h>
 #include <learnopengl/model_animation.h>
 
-
-
+#include "animation_format.h"
+#include "animation_lod.h"
+#include "baked_animation.h"
+#include "clustered_lighting.h"
+#include "frame_pacer.h"
+#include "job_system.h"
+#include "packed_mesh.h"
+#include "pose_blend.h"
+#include "resource_tracking.h"
+#include "skeleton.h"
+#include "skeleton_import.h"
+
+#include <chrono>
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void applyMouseMovement(double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
@@ -35,6 +50,10 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// capped to the monitor's refresh rate by the pacer, with events polled again before the view; F10 toggles the late poll
+FramePacerSettings framePacing;
+bool lateMouseSampling = true;
+
 glm::vec3 modelPosition(0.0f, 0.0f, 0.0f);
 float modelYaw = 0.0f;
 float orbitYaw = 0.0f;
@@ -43,6 +62,9 @@ float cameraDistance = 4.0f;
 
 bool isWalking = false;
 
+// what the character, its clips and textures hold in memory; F9 writes a snapshot
+ResourceRegistry resources;
+
 int main()
 {
 	// glfw: initialize and configure
@@ -66,6 +88,10 @@ int main()
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	const GLFWvidmode* videoMode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	if (videoMode && videoMode->refreshRate > 0)
+		framePacing.targetFps = static_cast<float>(videoMode->refreshRate);
+	glfwSwapInterval(framePacing.swapInterval);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
@@ -88,11 +114,16 @@ int main()
 	// -----------------------------
 	glEnable(GL_DEPTH_TEST);
 
-	// build and compile shaders
-	// -------------------------
+	// build and compile shaders; the fragment shader includes the clustered light loop
+	// -------------------------------------------------------------------------------
+	std::string litFragmentShader = includeClusteredLighting("../../src/8.guest/2020/skeletal_animation/anim_model.fs");
 	Shader ourShader(
 		"../../src/8.guest/2020/skeletal_animation/anim_model.vs",
-		"../../src/8.guest/2020/skeletal_animation/anim_model.fs"
+		litFragmentShader.c_str()
+	);
+	Shader crowdShader(
+		"../../src/8.guest/2020/skeletal_animation/anim_model_instanced.vs",
+		litFragmentShader.c_str()
 	);
 
 	// load models
@@ -100,7 +131,85 @@ int main()
 	Model ourModel(FileSystem::getPath("resources/objects/character/walking.dae"));
 	Animation walkAnimation(FileSystem::getPath("resources/objects/character/walking.dae"), &ourModel);
 	Animation standAnimation(FileSystem::getPath("resources/objects/character/standing.dae"), &ourModel);
-	Animator animator(&standAnimation);
+
+	// both clips resampled for the skeleton; the player crossfades between them instead of cutting
+	Skeleton skeleton = importSkeleton(walkAnimation, ourModel.GetBoneCount());
+	SkeletonClip walkClip = importClip(walkAnimation, skeleton, "walking.dae");
+	SkeletonClip standClip = importClip(standAnimation, skeleton, "standing.dae");
+	PoseAnimator animator(skeleton, &standClip);
+	trackModel(resources, FileSystem::getPath("resources/objects/character/walking.dae"), ourModel);
+	trackClip(resources, walkClip);
+	trackClip(resources, standClip);
+
+	// cook them for simulation_server, which has no assimp to read the .dae files
+	std::string animationPath = FileSystem::getPath("resources/animations/character.anim");
+	if (!std::filesystem::exists(animationPath))
+	{
+		std::filesystem::create_directories(std::filesystem::path(animationPath).parent_path());
+		if (writeAnimationFile(animationPath, skeleton, { &walkClip, &standClip }))
+			std::cout << "Cooked walk/stand clips to " << animationPath << std::endl;
+	}
+
+	// upload the character in the packed skinned vertex format
+	PackingStats characterPacking;
+	std::vector<std::unique_ptr<PackedMesh>> characterMeshes;
+	for (Mesh& mesh : ourModel.meshes)
+		characterMeshes.emplace_back(new PackedMesh(mesh.vertices, mesh.indices, mesh.textures, true, &characterPacking));
+	reportPacking("walking.dae", characterPacking);
+	size_t characterGpuBytes = 0;
+	for (auto& mesh : characterMeshes)
+		characterGpuBytes += mesh->GpuBytes;
+	resources.Track(RESOURCE_MESH, "walking.dae (packed)", 0, characterGpuBytes);
+
+	// background crowd: both clips baked into a bone texture, every character drawn in one instanced call per mesh
+	BakedAnimationTexture bakedClips(ourModel);
+	unsigned int bakedWalk = bakedClips.Bake(walkAnimation, "walking.dae");
+	unsigned int bakedStand = bakedClips.Bake(standAnimation, "standing.dae");
+	bakedClips.Upload();
+	resources.Track(RESOURCE_ANIMATION, "baked clips", 0, textureGpuBytes(bakedClips.Texture));
+
+	std::vector<PackedMesh*> crowdMeshes;
+	for (auto& mesh : characterMeshes)
+		crowdMeshes.push_back(mesh.get());
+	InstancedCrowd crowd(crowdMeshes, bakedClips);
+
+	// the nearest characters are animated individually on the CPU, at a level of detail that follows their size on screen
+	AnimationLodSystem animationLod(skeleton);
+
+	// rings around where the player starts; every other character walks its ring, the rest stand.
+	// the two inner rings go through the LOD system, the others are baked
+	const glm::vec3 crowdCenter = modelPosition;
+	const unsigned int CROWD_SIZE = 1024;
+	const unsigned int LOD_CHARACTERS = 128;
+	std::vector<CrowdInstance> crowdInstances(CROWD_SIZE - LOD_CHARACTERS);
+	std::vector<glm::mat4> lodModels(LOD_CHARACTERS);
+	std::vector<float> crowdRadius(CROWD_SIZE), crowdAngle(CROWD_SIZE);
+	for (unsigned int i = 0; i < CROWD_SIZE; i++)
+	{
+		unsigned int ring = i / 64;
+		crowdRadius[i] = 4.0f + ring * 1.0f;
+		crowdAngle[i] = glm::radians(360.0f / 64.0f * (i % 64) + ring * 11.0f);
+		float phase = (i * 37 % 100) / 100.0f;
+		float playbackRate = 0.9f + (i * 53 % 20) / 100.0f;
+		if (i < LOD_CHARACTERS)
+		{
+			const SkeletonClip* clip = i % 2 == 0 ? &walkClip : &standClip;
+			AnimatedCharacter& character = animationLod.Character(animationLod.Add(clip, glm::vec3(0.0f), 1.0f));
+			character.Time = phase * clip->Duration;
+			character.PlaybackRate = playbackRate;
+			continue;
+		}
+		CrowdInstance& instance = crowdInstances[i - LOD_CHARACTERS];
+		instance.clip = i % 2 == 0 ? bakedWalk : bakedStand;
+		instance.timeOffset = phase * bakedClips.Clips[instance.clip].duration;
+		instance.playbackRate = playbackRate;
+	}
+	float crowdTime = 0.0f;
+	float animationLodTime = 0.0f;
+	unsigned int crowdFrames = 0;
+	float statsTime = 0.0f;
+	bool snapshotKeyDown = false;
+	unsigned int snapshotCount = 0;
 
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -115,23 +224,10 @@ int main()
 		-20.0f, 0.0f, -20.0f,  0.0f, 1.0f, 0.0f,  0.0f, 2.0f,
 		 20.0f, 0.0f, -20.0f,  0.0f, 1.0f, 0.0f,  2.0f, 2.0f
 	};
-	unsigned int planeVAO, planeVBO;
-	glGenVertexArrays(1, &planeVAO);
-	glGenBuffers(1, &planeVBO);
-	glBindVertexArray(planeVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
-
-	// position
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-	// normal
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-	// texcoords
-	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-	glBindVertexArray(0);
+	PackingStats planePacking;
+	PackedMesh planeMesh(planeVertices, 6, &planePacking);
+	reportPacking("plane", planePacking);
+	resources.Track(RESOURCE_MESH, "plane", 0, planeMesh.GpuBytes);
 
 	unsigned int planeTexture;
 	glGenTextures(1, &planeTexture);
@@ -163,25 +259,77 @@ int main()
 		std::cout << "Failed to load texture" << std::endl;
 	}
 	stbi_image_free(data);
+	trackTexture(resources, FileSystem::getPath("resources/textures/marble.jpg"), planeTexture);
+
+	// memory budgets; crossing one prints a warning naming what could be evicted
+	resources.SetBudget(RESOURCE_TEXTURE, ResourceBudget{ 0, 64 * 1024 * 1024 });
+	resources.SetBudget(RESOURCE_MESH, ResourceBudget{ 64 * 1024 * 1024, 64 * 1024 * 1024 });
+	resources.SetBudget(RESOURCE_ANIMATION, ResourceBudget{ 64 * 1024 * 1024, 64 * 1024 * 1024 });
+	resources.SetTotalBudget(ResourceBudget{ 256 * 1024 * 1024, 256 * 1024 * 1024 });
+
+	// lights: a warm key light over the character and a ring of coloured lights around it
+	std::vector<Light> lights(1);
+	lights[0].position = glm::vec3(2.0f, 6.0f, -3.0f);
+	lights[0].color = glm::vec3(1.0f, 0.95f, 0.85f);
+	lights[0].intensity = 40.0f;
+	lights[0].range = 30.0f;
+	for (int i = 0; i < 8; i++)
+	{
+		float angle = glm::radians(45.0f * i);
+		Light light;
+		light.position = glm::vec3(6.0f * sin(angle), 1.0f, 6.0f * cos(angle));
+		light.color = glm::vec3(0.5f + 0.5f * sin(angle), 0.5f + 0.5f * cos(angle), 1.0f - 0.5f * sin(angle));
+		light.intensity = 4.0f;
+		light.range = 8.0f;
+		lights.push_back(light);
+	}
+
+	JobSystem jobs;
+	ClusteredLighting lighting;
+	FramePacer framePacer(framePacing);
+	bool lateMouseKeyDown = false;
 
 	// render loop
 	// -----------
 	while (!glfwWindowShouldClose(window))
 	{
+		// frame pacing: wait for this frame's slot, then poll IO events so the frame starts with fresh input
+		// ---------------------------------------------------------------------------------------------------
+		framePacer.Wait();
+		glfwPollEvents();
+		framePacer.MarkInput();
+
 		// per-frame time logic
 		// --------------------
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		// memory
+		// ------
+		resources.NextFrame();
+		resources.CheckBudgets();
+
 		// input
 		// -----
 		processInput(window);
-		Animation* currentAnim = isWalking ? &walkAnimation : &standAnimation;
-
-		if (animator.GetCurrentAnimation() != currentAnim)
+		bool snapshotKey = glfwGetKey(window, GLFW_KEY_F9) == GLFW_PRESS;
+		if (snapshotKey && !snapshotKeyDown)
 		{
-			animator.PlayAnimation(currentAnim);
+			std::string snapshotPath = "resources_" + std::to_string(snapshotCount++) + ".json";
+			if (resources.WriteSnapshot(snapshotPath))
+				std::cout << "Wrote resource snapshot " << snapshotPath << std::endl;
+		}
+		snapshotKeyDown = snapshotKey;
+		bool lateMouseKey = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+		if (lateMouseKey && !lateMouseKeyDown)
+			lateMouseSampling = !lateMouseSampling;
+		lateMouseKeyDown = lateMouseKey;
+		const SkeletonClip* currentClip = isWalking ? &walkClip : &standClip;
+
+		if (animator.GetCurrentAnimation() != currentClip)
+		{
+			animator.PlayAnimation(currentClip, 0.25f);
 		}
 
 		animator.UpdateAnimation(deltaTime);
@@ -194,6 +342,17 @@ int main()
 		// don't forget to enable shader before setting uniforms
 		ourShader.use();
 
+		// late input: mouse movement during the animation update still turns this frame's camera.
+		// The disabled cursor only moves while GLFW polls, so poll again; the input time only moves
+		// when the poll brought movement
+		if (lateMouseSampling)
+		{
+			float seenX = lastX, seenY = lastY;
+			glfwPollEvents();
+			if (lastX != seenX || lastY != seenY)
+				framePacer.MarkInput();
+		}
+
 		// คำนวณตำแหน่งกล้องตามมุม orbit
 		float yawRad = glm::radians(orbitYaw);
 		float pitchRad = glm::radians(orbitPitch);
@@ -213,9 +372,43 @@ int main()
 		ourShader.setMat4("projection", projection);
 		ourShader.setMat4("view", view);
 
-        auto transforms = animator.GetFinalBoneMatrices();
-		for (int i = 0; i < transforms.size(); ++i)
-			ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+		lighting.Update(lights, view, projection, jobs);
+		lighting.Bind(ourShader, framebufferWidth, framebufferHeight);
+
+		// move the crowd; the only per-character CPU work for the baked part is its model matrix
+		auto crowdStart = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < CROWD_SIZE; i++)
+		{
+			bool walking = i % 2 == 0;
+			if (walking)
+				crowdAngle[i] += deltaTime / crowdRadius[i];
+			glm::vec3 position = crowdCenter + glm::vec3(crowdRadius[i] * sin(crowdAngle[i]), 0.0f, crowdRadius[i] * cos(crowdAngle[i]));
+			glm::mat4 crowdModel = glm::mat4(1.0f);
+			crowdModel = glm::translate(crowdModel, position);
+			// walkers face along the ring, standers face the centre
+			crowdModel = glm::rotate(crowdModel, crowdAngle[i] + glm::radians(walking ? 90.0f : 180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			crowdModel = glm::scale(crowdModel, glm::vec3(0.5f));
+			if (i < LOD_CHARACTERS)
+			{
+				// bounding sphere around the body, which stands on its origin
+				animationLod.Character(i).Position = position + glm::vec3(0.0f, 0.9f, 0.0f);
+				lodModels[i] = crowdModel;
+			}
+			else
+				crowdInstances[i - LOD_CHARACTERS].model = crowdModel;
+		}
+		crowd.SetInstances(crowdInstances);
+		crowdTime += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - crowdStart).count();
+
+		animationLod.Update(deltaTime, projection * view, camera.Position, glm::radians(camera.Zoom), jobs);
+		animationLodTime += animationLod.Stats().totalMs;
+
+		// all bone matrices in one upload instead of a uniform lookup per bone
+		int boneMatricesLocation = glGetUniformLocation(ourShader.ID, "finalBonesMatrices");
+		const std::vector<glm::mat4>& transforms = animator.GetFinalBoneMatrices();
+		glUniformMatrix4fv(boneMatricesLocation, static_cast<GLsizei>(transforms.size()), GL_FALSE, glm::value_ptr(transforms[0]));
 
 		modelYaw = -orbitYaw;
 
@@ -225,7 +418,21 @@ int main()
 		model = glm::rotate(model, glm::radians(modelYaw), glm::vec3(0.0f, 1.0f, 0.0f));
 		model = glm::scale(model, glm::vec3(0.5f));
 		ourShader.setMat4("model", model);
-		ourModel.Draw(ourShader);
+		ourShader.setBool("useTexture", true);
+		for (auto& mesh : characterMeshes)
+			mesh->Draw(ourShader);
+
+		// render the LOD characters with whatever pose they last evaluated
+		for (unsigned int i = 0; i < animationLod.CharacterCount(); i++)
+		{
+			const AnimatedCharacter& character = animationLod.Character(i);
+			if (character.Lod == ANIM_LOD_OFFSCREEN || !character.Evaluated())
+				continue;
+			glUniformMatrix4fv(boneMatricesLocation, static_cast<GLsizei>(character.BoneMatrices.size()), GL_FALSE, glm::value_ptr(character.BoneMatrices[0]));
+			ourShader.setMat4("model", lodModels[i]);
+			for (auto& mesh : characterMeshes)
+				mesh->Draw(ourShader);
+		}
 
 		// render plane with texture
 		glm::mat4 modelPlane = glm::mat4(1.0f);
@@ -234,17 +441,53 @@ int main()
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, planeTexture);
 		ourShader.setInt("texture1", 0);
-		glBindVertexArray(planeVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-		glBindVertexArray(0);
+		planeMesh.Draw(ourShader);
+
+		// render the baked crowd
+		crowdShader.use();
+		crowdShader.setMat4("projection", projection);
+		crowdShader.setMat4("view", view);
+		// textured like the player: DrawInstanced binds each mesh's texture_diffuse1, and without
+		// useTexture the shader falls back to objectColor
+		crowdShader.setBool("useTexture", true);
+		crowdShader.setVec3("objectColor", glm::vec3(1.0f));
+		lighting.Bind(crowdShader, framebufferWidth, framebufferHeight);
+		crowd.Draw(crowdShader, currentFrame);
+
+		// once a second, show what the crowd costs on the CPU and how the LOD characters are split
+		crowdFrames++;
+		if (currentFrame - statsTime >= 1.0f)
+		{
+			const AnimationLodStats& lodStats = animationLod.Stats();
+			const FramePacerStats& pacing = framePacer.Stats();
+			std::string title = "LearnOpenGL | crowd of " + std::to_string(crowd.InstanceCount()) + " baked characters, " +
+				std::to_string(static_cast<int>(crowdTime / crowdFrames * 1000.0f)) + " us CPU per frame | LOD full/reduced/distant/offscreen " +
+				std::to_string(lodStats.characters[ANIM_LOD_FULL]) + "/" + std::to_string(lodStats.characters[ANIM_LOD_REDUCED]) + "/" +
+				std::to_string(lodStats.characters[ANIM_LOD_DISTANT]) + "/" + std::to_string(lodStats.characters[ANIM_LOD_OFFSCREEN]) + ", " +
+				std::to_string(static_cast<int>(animationLodTime / crowdFrames * 1000.0f)) + " us per frame | memory CPU " +
+				formatBytes(resources.Total().cpuBytes) + ", GPU " + formatBytes(resources.Total().gpuBytes) + " | " +
+				std::to_string(pacing.frames) + " fps (cap " + std::to_string(static_cast<int>(framePacing.targetFps)) + "), input latency " +
+				std::to_string(static_cast<int>(pacing.latencyMs * 1000.0f)) + " us mean " +
+				std::to_string(static_cast<int>(pacing.latencyP99Ms * 1000.0f)) + " us p99" + (lateMouseSampling ? " (late mouse)" : "");
+			glfwSetWindowTitle(window, title.c_str());
+			statsTime = currentFrame;
+			crowdTime = 0.0f;
+			animationLodTime = 0.0f;
+			crowdFrames = 0;
+		}
 
 
-		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-		// -------------------------------------------------------------------------------
+		// glfw: swap buffers; IO events are polled at the start of the next frame, after its wait
+		// ---------------------------------------------------------------------------------------
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		framePacer.MarkPresented();
 	}
 
+	// optional: de-allocate all resources once they've outlived their purpose; the context goes with glfwTerminate
+	// ------------------------------------------------------------------------------------------------------
+	planeMesh.Release();
+	characterMeshes.clear();
+
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
 	glfwTerminate();
@@ -297,10 +540,12 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 // -------------------------------------------------------
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
-	static float lastX = SCR_WIDTH / 2.0f;
-	static float lastY = SCR_HEIGHT / 2.0f;
-	static bool firstMouse = true;
+	applyMouseMovement(xpos, ypos);
+}
 
+// orbits the camera by the movement since the last position seen
+void applyMouseMovement(double xpos, double ypos)
+{
 	if (firstMouse)
 	{
 		lastX = xpos;
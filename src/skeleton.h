@@ -0,0 +1,214 @@
+#ifndef SKELETON_H
+#define SKELETON_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct JointPose {
+    glm::vec3 translation = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+inline glm::mat4 jointPoseMatrix(const JointPose& pose)
+{
+    glm::mat4 matrix = glm::mat4_cast(pose.rotation);
+    matrix[0] *= pose.scale.x;
+    matrix[1] *= pose.scale.y;
+    matrix[2] *= pose.scale.z;
+    matrix[3] = glm::vec4(pose.translation, 1.0f);
+    return matrix;
+}
+
+// splits a translate * rotate * scale matrix (what Bone::GetLocalTransform builds) back into its parts
+inline JointPose decomposeJointPose(const glm::mat4& matrix)
+{
+    JointPose pose;
+    pose.translation = glm::vec3(matrix[3]);
+    pose.scale = glm::vec3(glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])));
+    glm::mat3 rotation(glm::vec3(matrix[0]) / pose.scale.x, glm::vec3(matrix[1]) / pose.scale.y, glm::vec3(matrix[2]) / pose.scale.z);
+    pose.rotation = glm::normalize(glm::quat_cast(rotation));
+    return pose;
+}
+
+// A pose for every joint as structure of arrays: one stream per component, so blending handles
+// four joints per SIMD instruction. Streams are padded to a multiple of four with identity
+// joints, so vector loops need no scalar tail.
+struct PoseBuffer {
+    enum Channel { TX, TY, TZ, RX, RY, RZ, RW, SX, SY, SZ, CHANNEL_COUNT };
+
+    unsigned int JointCount = 0;
+    unsigned int Stride = 0;
+    std::vector<float> Data;
+
+    void Resize(unsigned int jointCount)
+    {
+        JointCount = jointCount;
+        Stride = (jointCount + 3) & ~3u;
+        Data.assign(static_cast<size_t>(Stride) * CHANNEL_COUNT, 0.0f);
+        std::fill(Channel(RW), Channel(RW) + Stride, 1.0f);
+        std::fill(Channel(SX), Channel(SX) + Stride * 3, 1.0f);
+    }
+
+    float* Channel(int channel) { return Data.data() + static_cast<size_t>(channel) * Stride; }
+    const float* Channel(int channel) const { return Data.data() + static_cast<size_t>(channel) * Stride; }
+
+    JointPose Get(unsigned int joint) const
+    {
+        JointPose pose;
+        pose.translation = glm::vec3(Channel(TX)[joint], Channel(TY)[joint], Channel(TZ)[joint]);
+        pose.rotation = glm::quat(Channel(RW)[joint], Channel(RX)[joint], Channel(RY)[joint], Channel(RZ)[joint]);
+        pose.scale = glm::vec3(Channel(SX)[joint], Channel(SY)[joint], Channel(SZ)[joint]);
+        return pose;
+    }
+
+    void Set(unsigned int joint, const JointPose& pose)
+    {
+        Channel(TX)[joint] = pose.translation.x;
+        Channel(TY)[joint] = pose.translation.y;
+        Channel(TZ)[joint] = pose.translation.z;
+        Channel(RX)[joint] = pose.rotation.x;
+        Channel(RY)[joint] = pose.rotation.y;
+        Channel(RZ)[joint] = pose.rotation.z;
+        Channel(RW)[joint] = pose.rotation.w;
+        Channel(SX)[joint] = pose.scale.x;
+        Channel(SY)[joint] = pose.scale.y;
+        Channel(SZ)[joint] = pose.scale.z;
+    }
+};
+
+// The node hierarchy of an animated model flattened into an array with every parent before its
+// children, so a pose goes from local to model space in one forward pass instead of a recursive
+// walk. Height is the length of the longest chain below a joint: 0 for leaves such as finger
+// tips, so level of detail can drop joints from the bottom of the tree up.
+class Skeleton
+{
+public:
+    struct Joint {
+        std::string name;
+        int parent;             // -1 for the root
+        int boneId;             // index into the final bone matrices, -1 for helper nodes that skin nothing
+        glm::mat4 offset;       // inverse bind matrix
+        glm::mat4 bindLocal;    // node transform, used when no clip animates the joint
+        unsigned int height;
+    };
+
+    std::vector<Joint> Joints;
+    unsigned int BoneCount = 0;
+
+    // parents must be added before their children; see skeleton_import.h for loaded models
+    unsigned int AddJoint(const std::string& name, int parent, int boneId, const glm::mat4& offset, const glm::mat4& bindLocal)
+    {
+        Joints.push_back(Joint{ name, parent, boneId, offset, bindLocal, 0 });
+        BoneCount = std::max(BoneCount, static_cast<unsigned int>(boneId + 1));
+        return static_cast<unsigned int>(Joints.size() - 1);
+    }
+
+    void Finalize()
+    {
+        for (Joint& joint : Joints)
+            joint.height = 0;
+        for (size_t i = Joints.size(); i-- > 0;)
+            if (Joints[i].parent >= 0)
+                Joints[Joints[i].parent].height = std::max(Joints[Joints[i].parent].height, Joints[i].height + 1);
+    }
+
+    int FindJoint(const std::string& name) const
+    {
+        for (unsigned int i = 0; i < Joints.size(); i++)
+            if (Joints[i].name == name)
+                return static_cast<int>(i);
+        return -1;
+    }
+
+    // local joint matrices to final skinning matrices, one pass in hierarchy order
+    void ComputeBoneMatrices(const std::vector<glm::mat4>& locals, std::vector<glm::mat4>& globals, std::vector<glm::mat4>& boneMatrices) const
+    {
+        globals.resize(Joints.size());
+        boneMatrices.resize(BoneCount, glm::mat4(1.0f));
+        for (unsigned int i = 0; i < Joints.size(); i++)
+        {
+            const Joint& joint = Joints[i];
+            globals[i] = joint.parent >= 0 ? globals[joint.parent] * locals[i] : locals[i];
+            if (joint.boneId >= 0)
+                boneMatrices[joint.boneId] = globals[i] * joint.offset;
+        }
+    }
+};
+
+// An animation clip resampled at a fixed rate into one local pose per joint per frame.
+// Sampling is read-only, so many characters can evaluate the same clip on different threads,
+// which the keyframe cursors inside learnopengl's Bone do not allow. Nothing here needs GL or
+// assimp; skeleton_import.h builds skeletons and clips from a loaded Animation.
+class SkeletonClip
+{
+public:
+    std::string Name;
+    float Duration;             // seconds
+    float FramesPerSecond;      // frameCount frames span the clip exactly, so it loops seamlessly
+    unsigned int FrameCount;
+
+    // every joint starts at its bind pose and unanimated
+    SkeletonClip(const Skeleton& skeleton, const std::string& name, float duration, unsigned int frameCount)
+        : Name(name), Duration(duration), FramesPerSecond(frameCount / duration), FrameCount(frameCount),
+          m_JointCount(static_cast<unsigned int>(skeleton.Joints.size())), m_Animated(m_JointCount, 0), m_Frames(frameCount)
+    {
+        for (PoseBuffer& frame : m_Frames)
+        {
+            frame.Resize(m_JointCount);
+            for (unsigned int joint = 0; joint < m_JointCount; joint++)
+                frame.Set(joint, decomposeJointPose(skeleton.Joints[joint].bindLocal));
+        }
+    }
+
+    unsigned int JointCount() const { return m_JointCount; }
+    bool Animated(unsigned int joint) const { return m_Animated[joint] != 0; }
+    void SetAnimated(unsigned int joint, bool animated) { m_Animated[joint] = animated ? 1 : 0; }
+    JointPose Key(unsigned int frame, unsigned int joint) const { return m_Frames[frame].Get(joint); }
+    void SetKey(unsigned int frame, unsigned int joint, const JointPose& pose) { m_Frames[frame].Set(joint, pose); }
+    const PoseBuffer& Frame(unsigned int frame) const { return m_Frames[frame]; }
+
+    size_t MemoryBytes() const
+    {
+        size_t bytes = m_Animated.capacity() + m_Frames.capacity() * sizeof(PoseBuffer);
+        for (const PoseBuffer& frame : m_Frames)
+            bytes += frame.Data.capacity() * sizeof(float);
+        return bytes;
+    }
+
+    // the two keyframes around time (seconds, wrapped) and the blend between them
+    void FramesAt(float time, unsigned int& frame0, unsigned int& frame1, float& blend) const
+    {
+        float frame = std::fmod(time * FramesPerSecond, static_cast<float>(FrameCount));
+        if (frame < 0.0f)
+            frame += FrameCount;
+        frame0 = std::min(static_cast<unsigned int>(frame), FrameCount - 1);
+        frame1 = (frame0 + 1) % FrameCount;
+        blend = frame - frame0;
+    }
+
+    JointPose Sample(unsigned int joint, unsigned int frame0, unsigned int frame1, float blend) const
+    {
+        JointPose a = Key(frame0, joint);
+        JointPose b = Key(frame1, joint);
+        JointPose pose;
+        pose.translation = glm::mix(a.translation, b.translation, blend);
+        pose.rotation = glm::slerp(a.rotation, b.rotation, blend);
+        pose.scale = glm::mix(a.scale, b.scale, blend);
+        return pose;
+    }
+
+private:
+    unsigned int m_JointCount;
+    std::vector<uint8_t> m_Animated;
+    std::vector<PoseBuffer> m_Frames;
+};
+
+#endif
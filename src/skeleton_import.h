@@ -0,0 +1,60 @@
+#ifndef SKELETON_IMPORT_H
+#define SKELETON_IMPORT_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/animation.h>
+#include <learnopengl/bone.h>
+
+#include "skeleton.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+
+// Skeletons and clips from animations loaded through learnopengl (assimp). Kept apart from
+// skeleton.h so code that only evaluates poses, such as the benchmarks, builds without either.
+
+inline void importSkeletonNode(Animation& animation, const AssimpNodeData* node, int parent, unsigned int boneCount, Skeleton& skeleton)
+{
+    const std::map<std::string, BoneInfo>& boneInfoMap = animation.GetBoneIDMap();
+    auto info = boneInfoMap.find(node->name);
+    bool skins = info != boneInfoMap.end() && info->second.id < static_cast<int>(boneCount);
+    int index = static_cast<int>(skeleton.AddJoint(node->name, parent, skins ? info->second.id : -1,
+                                                   skins ? info->second.offset : glm::mat4(1.0f), node->transformation));
+    for (int i = 0; i < node->childrenCount; i++)
+        importSkeletonNode(animation, &node->children[i], index, boneCount, skeleton);
+}
+
+// the node tree and bone table of an Animation loaded against the model
+inline Skeleton importSkeleton(Animation& animation, unsigned int boneCount)
+{
+    Skeleton skeleton;
+    importSkeletonNode(animation, &animation.GetRootNode(), -1, boneCount, skeleton);
+    skeleton.BoneCount = std::max(skeleton.BoneCount, boneCount);
+    skeleton.Finalize();
+    return skeleton;
+}
+
+// samples every channel of a loaded Animation at sampleRate
+inline SkeletonClip importClip(Animation& animation, const Skeleton& skeleton, const std::string& name, float sampleRate = 30.0f)
+{
+    float duration = animation.GetDuration() / animation.GetTicksPerSecond();
+    SkeletonClip clip(skeleton, name, duration, std::max(1u, static_cast<unsigned int>(std::ceil(duration * sampleRate))));
+    for (unsigned int joint = 0; joint < clip.JointCount(); joint++)
+    {
+        Bone* bone = animation.FindBone(skeleton.Joints[joint].name);
+        if (!bone)
+            continue;
+        clip.SetAnimated(joint, true);
+        for (unsigned int frame = 0; frame < clip.FrameCount; frame++)
+        {
+            bone->Update(frame / clip.FramesPerSecond * animation.GetTicksPerSecond());
+            clip.SetKey(frame, joint, decomposeJointPose(bone->GetLocalTransform()));
+        }
+    }
+    return clip;
+}
+
+#endif
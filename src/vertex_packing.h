@@ -0,0 +1,394 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Compact vertex formats shared by the static and skinned shaders:
+//
+//   position   half4 (8 bytes) when half precision is good enough for the mesh, else float3 (12)
+//   normal     octahedral, 2 x snorm16 (4)
+//   texcoords  half2 (4)
+//   bone ids   4 x uint8 (4)           skinned only
+//   weights    4 x unorm8, sum 255 (4) skinned only
+//
+// Static vertices shrink from 32 bytes (plane/cube arrays) or 88 (learnopengl Vertex) to 16,
+// skinned ones from 88 to 24. Tangents and bitangents are dropped: no shader reads them.
+
+struct PackedVertexLayout {
+    bool halfPositions;
+    bool skinned;
+    unsigned int stride;
+    unsigned int normalOffset;
+    unsigned int texCoordOffset;
+    unsigned int boneIdOffset;
+    unsigned int weightOffset;
+};
+
+// what packing did to one mesh; summed per model for the load-time report
+struct PackingStats {
+    size_t sourceBytes = 0;     // vertex + index bytes before packing
+    size_t packedBytes = 0;     // after packing, dedup and index narrowing
+    size_t sourceVertices = 0;
+    size_t packedVertices = 0;
+    double acmrBefore = 0.0;    // average cache misses per triangle (16-entry FIFO)
+    double acmrAfter = 0.0;
+    size_t triangles = 0;
+
+    void Add(const PackingStats& other)
+    {
+        acmrBefore = (acmrBefore * triangles + other.acmrBefore * other.triangles) / std::max<size_t>(triangles + other.triangles, 1);
+        acmrAfter = (acmrAfter * triangles + other.acmrAfter * other.triangles) / std::max<size_t>(triangles + other.triangles, 1);
+        sourceBytes += other.sourceBytes;
+        packedBytes += other.packedBytes;
+        sourceVertices += other.sourceVertices;
+        packedVertices += other.packedVertices;
+        triangles += other.triangles;
+    }
+};
+
+// source attributes in a packing-friendly form, filled from whichever vertex struct the caller has
+struct UnpackedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+    int boneIds[4];
+    float weights[4];
+};
+
+// CPU-side result, ready for glBufferData
+struct PackedGeometry {
+    PackedVertexLayout layout;
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;   // uint16 when the vertex count allows it, else uint32
+    bool shortIndices;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+};
+
+inline PackedVertexLayout makePackedLayout(bool halfPositions, bool skinned)
+{
+    PackedVertexLayout layout;
+    layout.halfPositions = halfPositions;
+    layout.skinned = skinned;
+    layout.normalOffset = halfPositions ? 8 : 12;
+    layout.texCoordOffset = layout.normalOffset + 4;
+    layout.boneIdOffset = layout.texCoordOffset + 4;
+    layout.weightOffset = layout.boneIdOffset + 4;
+    layout.stride = skinned ? layout.weightOffset + 4 : layout.boneIdOffset;
+    return layout;
+}
+
+// octahedral mapping of a unit vector onto the [-1, 1] square
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+    n /= std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        e.x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        e.y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return e;
+}
+
+inline glm::vec3 octDecode(glm::vec2 e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - std::fabs(e.x) - std::fabs(e.y));
+    if (n.z < 0.0f)
+    {
+        float x = (1.0f - std::fabs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+        float y = (1.0f - std::fabs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+        n.x = x;
+        n.y = y;
+    }
+    return glm::normalize(n);
+}
+
+inline int16_t packSnorm16(float v)
+{
+    return static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(1.0f, v)) * 32767.0f));
+}
+
+// half precision keeps 11 significant bits; accept it when no coordinate moves by more than
+// maxRelativeError of the mesh extent (the default is roughly one pixel at full screen height)
+inline bool halfPositionsFit(const std::vector<UnpackedVertex>& vertices, float maxRelativeError)
+{
+    glm::vec3 minP(FLT_MAX), maxP(-FLT_MAX);
+    for (const UnpackedVertex& vertex : vertices)
+    {
+        minP = glm::min(minP, vertex.position);
+        maxP = glm::max(maxP, vertex.position);
+    }
+    glm::vec3 size = maxP - minP;
+    float maxError = std::max(std::max(size.x, size.y), size.z) * maxRelativeError;
+
+    for (const UnpackedVertex& vertex : vertices)
+        for (int c = 0; c < 3; c++)
+        {
+            float value = vertex.position[c];
+            if (std::fabs(value) > 65504.0f || std::fabs(glm::unpackHalf1x16(glm::packHalf1x16(value)) - value) > maxError)
+                return false;
+        }
+    return true;
+}
+
+// 8-bit weights that still sum to exactly 255, so skinned positions never drift from unit weight
+inline void quantizeWeights(const UnpackedVertex& vertex, uint8_t ids[4], uint8_t weights[4])
+{
+    float total = 0.0f;
+    for (int i = 0; i < 4; i++)
+        if (vertex.boneIds[i] >= 0 && vertex.boneIds[i] < 256)
+            total += vertex.weights[i];
+
+    int sum = 0, largest = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        bool used = vertex.boneIds[i] >= 0 && vertex.boneIds[i] < 256 && total > 0.0f;
+        ids[i] = used ? static_cast<uint8_t>(vertex.boneIds[i]) : 0;
+        weights[i] = used ? static_cast<uint8_t>(std::lround(vertex.weights[i] / total * 255.0f)) : 0;
+        sum += weights[i];
+        if (weights[i] > weights[largest])
+            largest = i;
+    }
+    if (sum > 0)
+        weights[largest] = static_cast<uint8_t>(weights[largest] + (255 - sum));
+}
+
+// average cache miss ratio of an index buffer on a simulated FIFO post-transform cache
+inline double simulateAcmr(const std::vector<unsigned int>& indices, unsigned int cacheSize = 16)
+{
+    if (indices.empty())
+        return 0.0;
+    std::vector<unsigned int> fifo;
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (std::find(fifo.begin(), fifo.end(), index) != fifo.end())
+            continue;
+        misses++;
+        fifo.push_back(index);
+        if (fifo.size() > cacheSize)
+            fifo.erase(fifo.begin());
+    }
+    return static_cast<double>(misses) / (indices.size() / 3);
+}
+
+// Tom Forsyth's linear-speed vertex cache optimisation: greedily emits the triangle whose
+// vertices score best against a simulated LRU cache, preferring vertices with few triangles left
+inline std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, unsigned int vertexCount)
+{
+    const int cacheSize = 32;
+    const size_t triangleCount = indices.size() / 3;
+
+    auto vertexScore = [](int cachePosition, unsigned int remaining) {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+            score = cachePosition < 3 ? 0.75f : std::pow(1.0f - (cachePosition - 3) / float(cacheSize - 3), 1.5f);
+        return score + 2.0f / std::sqrt(static_cast<float>(remaining));
+    };
+
+    std::vector<unsigned int> remaining(vertexCount, 0);
+    for (unsigned int index : indices)
+        remaining[index]++;
+    std::vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+    std::vector<unsigned int> vertexTriangles(indices.size());
+    std::vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (int c = 0; c < 3; c++)
+            vertexTriangles[fill[indices[t * 3 + c]]++] = static_cast<unsigned int>(t);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> score(vertexCount);
+    for (unsigned int v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> cache, result;
+    result.reserve(indices.size());
+    size_t scanCursor = 0;
+    long long best = -1;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+    {
+        if (best < 0)
+        {
+            // nothing in the cache touches a live triangle: fall back to the next unemitted one
+            while (emitted[scanCursor])
+                scanCursor++;
+            best = static_cast<long long>(scanCursor);
+        }
+
+        emitted[best] = true;
+        std::vector<unsigned int> newCache;
+        for (int c = 0; c < 3; c++)
+        {
+            unsigned int v = indices[best * 3 + c];
+            result.push_back(v);
+            newCache.push_back(v);
+            // swap the triangle out of the vertex's live list
+            unsigned int* live = &vertexTriangles[firstTriangle[v]];
+            unsigned int* found = std::find(live, live + remaining[v], static_cast<unsigned int>(best));
+            *found = live[remaining[v] - 1];
+            remaining[v]--;
+        }
+        for (unsigned int v : cache)
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+
+        for (unsigned int v : cache)
+            cachePosition[v] = -1;
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < static_cast<size_t>(cacheSize) ? static_cast<int>(i) : -1;
+        }
+
+        // rescore everything that was or is in the cache, then pick the best live triangle around it
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+            for (unsigned int i = 0; i < remaining[v]; i++)
+            {
+                unsigned int t = vertexTriangles[firstTriangle[v] + i];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+            }
+        }
+        for (unsigned int v : newCache)
+            for (unsigned int i = 0; i < remaining[v]; i++)
+            {
+                unsigned int t = vertexTriangles[firstTriangle[v] + i];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+
+        if (newCache.size() > static_cast<size_t>(cacheSize))
+            newCache.resize(cacheSize);
+        cache.swap(newCache);
+    }
+    return result;
+}
+
+// Packs one mesh: quantizes attributes, merges vertices that became identical, reorders
+// triangles for the post-transform cache and then vertices in first-use order for fetch locality.
+inline PackedGeometry packGeometry(const std::vector<UnpackedVertex>& source, const std::vector<unsigned int>& sourceIndices,
+                                   bool skinned, PackingStats* stats = nullptr, float maxRelativePositionError = 1.0f / 2048.0f)
+{
+    PackedGeometry geometry;
+    geometry.layout = makePackedLayout(halfPositionsFit(source, maxRelativePositionError), skinned);
+    const PackedVertexLayout& layout = geometry.layout;
+
+    // quantize every source vertex, then weld the byte-identical ones
+    std::vector<uint8_t> quantized(source.size() * layout.stride, 0);
+    for (size_t v = 0; v < source.size(); v++)
+    {
+        uint8_t* out = &quantized[v * layout.stride];
+        const UnpackedVertex& vertex = source[v];
+        if (layout.halfPositions)
+        {
+            uint16_t position[4] = { glm::packHalf1x16(vertex.position.x), glm::packHalf1x16(vertex.position.y),
+                                     glm::packHalf1x16(vertex.position.z), glm::packHalf1x16(1.0f) };
+            std::memcpy(out, position, sizeof(position));
+        }
+        else
+            std::memcpy(out, &vertex.position, sizeof(glm::vec3));
+
+        glm::vec3 normal = glm::dot(vertex.normal, vertex.normal) > 0.0f ? glm::normalize(vertex.normal) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec2 oct = octEncode(normal);
+        int16_t packedNormal[2] = { packSnorm16(oct.x), packSnorm16(oct.y) };
+        std::memcpy(out + layout.normalOffset, packedNormal, sizeof(packedNormal));
+
+        uint16_t texCoords[2] = { glm::packHalf1x16(vertex.texCoords.x), glm::packHalf1x16(vertex.texCoords.y) };
+        std::memcpy(out + layout.texCoordOffset, texCoords, sizeof(texCoords));
+
+        if (skinned)
+            quantizeWeights(vertex, out + layout.boneIdOffset, out + layout.weightOffset);
+    }
+
+    std::unordered_map<std::string, unsigned int> unique;
+    std::vector<unsigned int> weld(source.size());
+    unsigned int uniqueCount = 0;
+    for (size_t v = 0; v < source.size(); v++)
+    {
+        std::string key(reinterpret_cast<const char*>(&quantized[v * layout.stride]), layout.stride);
+        auto inserted = unique.insert(std::make_pair(key, uniqueCount));
+        if (inserted.second)
+        {
+            if (uniqueCount != v)
+                std::memcpy(&quantized[uniqueCount * layout.stride], &quantized[v * layout.stride], layout.stride);
+            uniqueCount++;
+        }
+        weld[v] = inserted.first->second;
+    }
+
+    std::vector<unsigned int> indices(sourceIndices.size());
+    for (size_t i = 0; i < sourceIndices.size(); i++)
+        indices[i] = weld[sourceIndices[i]];
+    double acmrBefore = simulateAcmr(indices);
+    indices = optimizeVertexCache(indices, uniqueCount);
+
+    // fetch order: vertices laid out in the order the optimized index buffer first touches them
+    std::vector<unsigned int> fetchRemap(uniqueCount, ~0u);
+    unsigned int next = 0;
+    geometry.vertices.resize(static_cast<size_t>(uniqueCount) * layout.stride);
+    for (unsigned int& index : indices)
+    {
+        if (fetchRemap[index] == ~0u)
+        {
+            std::memcpy(&geometry.vertices[next * layout.stride], &quantized[index * layout.stride], layout.stride);
+            fetchRemap[index] = next++;
+        }
+        index = fetchRemap[index];
+    }
+    geometry.vertices.resize(static_cast<size_t>(next) * layout.stride);
+    geometry.vertexCount = next;
+    geometry.indexCount = static_cast<unsigned int>(indices.size());
+
+    geometry.shortIndices = next <= 65536;
+    if (geometry.shortIndices)
+    {
+        geometry.indices.resize(indices.size() * sizeof(uint16_t));
+        uint16_t* out = reinterpret_cast<uint16_t*>(geometry.indices.data());
+        for (size_t i = 0; i < indices.size(); i++)
+            out[i] = static_cast<uint16_t>(indices[i]);
+    }
+    else
+    {
+        geometry.indices.resize(indices.size() * sizeof(uint32_t));
+        std::memcpy(geometry.indices.data(), indices.data(), geometry.indices.size());
+    }
+
+    if (stats)
+    {
+        stats->acmrBefore = acmrBefore;
+        stats->acmrAfter = simulateAcmr(indices);
+        stats->triangles = indices.size() / 3;
+        stats->sourceVertices = source.size();
+        stats->packedVertices = next;
+        stats->packedBytes = geometry.vertices.size() + geometry.indices.size();
+    }
+    return geometry;
+}
+
+#endif
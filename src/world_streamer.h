@@ -0,0 +1,230 @@
+#ifndef WORLD_STREAMER_H
+#define WORLD_STREAMER_H
+
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "scene_format.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+struct WorldStreamerSettings {
+    int loadRadius = 2;                             // chunks (Chebyshev distance) kept resident around the focus
+    int unloadRadius = 3;                           // must be > loadRadius so chunks on the border don't thrash
+    size_t maxResidentBytes = 4 * 1024 * 1024;      // resident + in-flight chunk memory
+    unsigned int maxLoadsInFlight = 4;
+};
+
+// runtime copy of a scene entity; color starts as the material color and is free to change
+struct ResidentEntity {
+    SceneEntity data;
+    glm::vec3 color;
+    unsigned int lodLevel;
+};
+
+struct ResidentChunk {
+    int x;
+    int z;
+    size_t bytes;
+    std::vector<ResidentEntity> entities;
+};
+
+// Keeps the chunks around a focus point resident. Chunk payloads are read and decoded on the
+// job system; Update() runs on the render thread, publishes finished loads and evicts chunks
+// that drifted out of range or no longer fit in the memory budget.
+class WorldStreamer
+{
+public:
+    WorldStreamer(const SceneFile& scene, JobSystem& jobs, const WorldStreamerSettings& settings = WorldStreamerSettings())
+        : m_Scene(scene), m_Jobs(jobs), m_Settings(settings)
+    {
+    }
+
+    ~WorldStreamer()
+    {
+        // in-flight jobs reference this object
+        m_Jobs.WaitIdle();
+    }
+
+    void Update(const glm::vec3& focus)
+    {
+        glm::ivec2 center = sceneChunkCoord(focus, m_Scene.ChunkSize);
+        publishFinishedLoads(center);
+        evict(center);
+        requestLoads(center);
+    }
+
+    // blocks until everything around focus is resident; used once at startup
+    void LoadImmediately(const glm::vec3& focus)
+    {
+        Update(focus);
+        while (!m_Pending.empty())
+        {
+            m_Jobs.WaitIdle();
+            Update(focus);
+        }
+    }
+
+    const std::map<std::pair<int, int>, std::unique_ptr<ResidentChunk>>& ResidentChunks() const { return m_Resident; }
+    size_t ResidentBytes() const { return m_ResidentBytes; }
+    size_t PendingBytes() const { return m_PendingBytes; }
+    size_t LoadsInFlight() const { return m_Pending.size(); }
+
+private:
+    const SceneFile& m_Scene;
+    JobSystem& m_Jobs;
+    WorldStreamerSettings m_Settings;
+
+    std::map<std::pair<int, int>, std::unique_ptr<ResidentChunk>> m_Resident;
+    std::set<std::pair<int, int>> m_Pending;
+    std::set<std::pair<int, int>> m_Failed;     // unreadable chunks are not requested again
+    size_t m_ResidentBytes = 0;
+    size_t m_PendingBytes = 0;
+
+    // written by workers, drained by the render thread
+    std::mutex m_FinishedMutex;
+    std::vector<std::unique_ptr<ResidentChunk>> m_Finished;
+    std::vector<int> m_FailedLoads;
+
+    static size_t chunkBytes(const SceneChunkRecord& record)
+    {
+        return sizeof(ResidentChunk) + record.entityCount * sizeof(ResidentEntity);
+    }
+
+    static int chunkDistance(int x, int z, const glm::ivec2& center)
+    {
+        return std::max(std::abs(x - center.x), std::abs(z - center.y));
+    }
+
+    void publishFinishedLoads(const glm::ivec2& center)
+    {
+        std::vector<std::unique_ptr<ResidentChunk>> finished;
+        std::vector<int> failed;
+        {
+            std::lock_guard<std::mutex> lock(m_FinishedMutex);
+            finished.swap(m_Finished);
+            failed.swap(m_FailedLoads);
+        }
+
+        for (int index : failed)
+        {
+            const SceneChunkRecord& record = m_Scene.Chunks[index];
+            std::pair<int, int> key(record.x, record.z);
+            m_Pending.erase(key);
+            m_PendingBytes -= chunkBytes(record);
+            m_Failed.insert(key);
+        }
+
+        for (std::unique_ptr<ResidentChunk>& chunk : finished)
+        {
+            std::pair<int, int> key(chunk->x, chunk->z);
+            m_Pending.erase(key);
+            m_PendingBytes -= chunk->bytes;
+
+            // the focus may have moved on while the chunk was loading
+            if (chunkDistance(chunk->x, chunk->z, center) > m_Settings.unloadRadius)
+                continue;
+            m_ResidentBytes += chunk->bytes;
+            m_Resident[key] = std::move(chunk);
+        }
+    }
+
+    void evict(const glm::ivec2& center)
+    {
+        for (auto it = m_Resident.begin(); it != m_Resident.end();)
+        {
+            if (chunkDistance(it->second->x, it->second->z, center) > m_Settings.unloadRadius)
+            {
+                m_ResidentBytes -= it->second->bytes;
+                it = m_Resident.erase(it);
+            }
+            else
+                ++it;
+        }
+
+        // over budget: drop the farthest chunks that are outside the load radius first
+        if (m_ResidentBytes + m_PendingBytes <= m_Settings.maxResidentBytes)
+            return;
+        std::vector<std::pair<int, std::pair<int, int>>> candidates;
+        for (const auto& entry : m_Resident)
+        {
+            int distance = chunkDistance(entry.second->x, entry.second->z, center);
+            if (distance > m_Settings.loadRadius)
+                candidates.push_back(std::make_pair(distance, entry.first));
+        }
+        std::sort(candidates.rbegin(), candidates.rend());
+        for (const auto& candidate : candidates)
+        {
+            if (m_ResidentBytes + m_PendingBytes <= m_Settings.maxResidentBytes)
+                break;
+            m_ResidentBytes -= m_Resident[candidate.second]->bytes;
+            m_Resident.erase(candidate.second);
+        }
+    }
+
+    void requestLoads(const glm::ivec2& center)
+    {
+        // nearest chunks first so the area under the player is never starved by the horizon
+        std::vector<std::pair<int, int>> wanted;
+        for (int z = center.y - m_Settings.loadRadius; z <= center.y + m_Settings.loadRadius; z++)
+            for (int x = center.x - m_Settings.loadRadius; x <= center.x + m_Settings.loadRadius; x++)
+            {
+                std::pair<int, int> key(x, z);
+                if (m_Scene.FindChunk(x, z) >= 0 && !m_Resident.count(key) && !m_Pending.count(key) && !m_Failed.count(key))
+                    wanted.push_back(key);
+            }
+        std::sort(wanted.begin(), wanted.end(), [&center](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+            int dxA = a.first - center.x, dzA = a.second - center.y;
+            int dxB = b.first - center.x, dzB = b.second - center.y;
+            return dxA * dxA + dzA * dzA < dxB * dxB + dzB * dzB;
+        });
+
+        for (const std::pair<int, int>& key : wanted)
+        {
+            if (m_Pending.size() >= m_Settings.maxLoadsInFlight)
+                break;
+            int index = m_Scene.FindChunk(key.first, key.second);
+            size_t bytes = chunkBytes(m_Scene.Chunks[index]);
+            if (m_ResidentBytes + m_PendingBytes + bytes > m_Settings.maxResidentBytes)
+                break;
+
+            m_Pending.insert(key);
+            m_PendingBytes += bytes;
+            m_Jobs.Submit([this, index]() { loadChunk(index); });
+        }
+    }
+
+    // worker thread
+    void loadChunk(int index)
+    {
+        const SceneChunkRecord& record = m_Scene.Chunks[index];
+        std::vector<SceneEntity> entities;
+        if (!m_Scene.LoadChunk(index, entities))
+        {
+            // publishing an empty chunk would hide the error as a hole in the world
+            std::lock_guard<std::mutex> lock(m_FinishedMutex);
+            m_FailedLoads.push_back(index);
+            return;
+        }
+
+        std::unique_ptr<ResidentChunk> chunk(new ResidentChunk());
+        chunk->x = record.x;
+        chunk->z = record.z;
+        chunk->entities.reserve(entities.size());
+        for (const SceneEntity& entity : entities)
+            chunk->entities.push_back(ResidentEntity{ entity, m_Scene.Materials[entity.material].color, 0 });
+        chunk->bytes = chunkBytes(record);
+
+        std::lock_guard<std::mutex> lock(m_FinishedMutex);
+        m_Finished.push_back(std::move(chunk));
+    }
+};
+
+#endif